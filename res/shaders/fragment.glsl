@@ -4,15 +4,13 @@
 in vec3 m_normal;
 in vec4 m_vertex;
 in vec2 m_texcoord;
+in vec4 m_tangent;
 
-// Textures
-uniform sampler2D u_ambientTex;
-uniform sampler2D u_diffuseTex;
-uniform sampler2D u_specularTex;
-uniform sampler2D u_specularHighTex;
-uniform sampler2D u_bumpTex;
-uniform sampler2D u_reflectionTex;
-uniform sampler2D u_alphaTex;
+// Textures: the model's texture arrays. Per material slot (ambient, diffuse,
+// specular, specular highlight, bump, reflection, alpha) the Material block's
+// uMaterialTextures holds the array's unit and the layer, which is negative
+// when the material has no such texture
+uniform sampler2DArray uTextureArrays[16];
 
 // Constants
 const int num_lights = 5;
@@ -22,18 +20,32 @@ out vec4 fragColor;
 
 // Uniforms
 uniform mat4 uModelView;
-uniform vec4 light_posn[num_lights];  // Light positions (in eye space)
-uniform vec4 light_col[num_lights];   // Light colors
-
-uniform vec3 ambient;
-uniform vec3 diffuse;
-uniform vec3 specular;
-uniform vec3 transmittance;
-uniform vec3 emission;
-uniform float ior;
-uniform float dissolve;
-uniform float shininess;
-uniform int illum;
+
+// Per-frame values shared by every program (UniformBuffers::setFrame)
+layout(std140) uniform Frame {
+    mat4 uView;
+    mat4 uProjection;
+    mat4 uViewProj;
+    vec4 light_posn[5];  // Light positions (in eye space)
+    vec4 light_col[5];   // Light colors
+    vec4 uSunDir;
+    vec4 uSunColor;
+    vec4 uAmbient;
+};
+
+// The bound material's record (UniformBuffers::bindMaterial)
+layout(std140) uniform Material {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 transmittance;
+    vec4 emission;
+    float shininess;
+    float ior;
+    float dissolve;
+    int illum;
+    ivec2 uMaterialTextures[7];
+};
 
 // Compute Phong Lighting
 vec4 compute_lighting(vec3 direction, vec4 lightcolor, vec3 normal, vec3 halfvec, vec4 mydiffuse, vec4 myspecular, float myshininess, float distance) {
@@ -48,23 +60,39 @@ vec4 compute_lighting(vec3 direction, vec4 lightcolor, vec3 normal, vec3 halfvec
     return lambert + phong;
 }
 
+// Empty slots read as black, like an unbound texture unit
+vec4 sampleMaterial(int slot) {
+    ivec2 t = uMaterialTextures[slot];
+    if (t.y < 0) return vec4(0.0, 0.0, 0.0, 1.0);
+    return texture(uTextureArrays[t.x], vec3(m_texcoord, float(t.y)));
+}
+
 void main() {
 
     // Sample textures
-    vec4 ambientColor = texture(u_ambientTex, m_texcoord);
-    vec4 diffuseColor = texture(u_diffuseTex, m_texcoord);
-    vec4 specularColor = texture(u_specularTex, m_texcoord);
-    vec4 specularHighlight = texture(u_specularHighTex, m_texcoord);
-    vec4 bumpMap = texture(u_bumpTex, m_texcoord);
-    vec4 reflectionColor = texture(u_reflectionTex, m_texcoord);
-    vec4 alphaColor = texture(u_alphaTex, m_texcoord);
+    vec4 ambientColor = sampleMaterial(0);
+    vec4 diffuseColor = sampleMaterial(1);
+    vec4 specularColor = sampleMaterial(2);
+    vec4 specularHighlight = sampleMaterial(3);
+    vec4 bumpMap = sampleMaterial(4);
+    vec4 reflectionColor = sampleMaterial(5);
+    vec4 alphaColor = sampleMaterial(6);
 
     float ambient_light = 0.5;
     // Start with ambient color
-    vec4 finalColor = vec4((ambient * ambientColor.xyz) * ambient_light, 1.0);
+    vec4 finalColor = vec4((ambient.xyz * ambientColor.xyz) * ambient_light, 1.0);
 
-    // Normalize normal
-    vec3 normal = normalize(m_normal + bumpMap.rgb * 2.0 - 1.0);
+    // Tangent-space normal map, re-orthogonalized after interpolation; height
+    // bump maps were turned into normals when decoded
+    vec3 normal = normalize(m_normal);
+    if (uMaterialTextures[4].y >= 0) {
+        vec3 tangent = normalize(m_tangent.xyz - normal * dot(normal, m_tangent.xyz));
+        vec3 bitangent = cross(normal, tangent) * m_tangent.w;
+        // z is rebuilt from x and y, which is all a compressed (BC5) normal map keeps
+        vec2 xy = bumpMap.rg * 2.0 - 1.0;
+        vec3 mapped = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+        normal = normalize(mat3(tangent, bitangent, normal) * mapped);
+    }
 
     // Eye position is at (0,0,0) in eye space
     vec3 mypos = m_vertex.xyz;  // No need for division by w
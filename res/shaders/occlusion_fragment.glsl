@@ -0,0 +1,8 @@
+#version 410 core
+
+// Proxy boxes only feed occlusion queries; color writes are masked off.
+out vec4 FragColor;
+
+void main(){
+    FragColor = vec4(1.0);
+}
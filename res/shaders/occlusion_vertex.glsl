@@ -0,0 +1,11 @@
+#version 410 core
+
+layout(location=0) in vec3 aPos; // unit cube corner
+
+uniform mat4 uMVP;
+uniform vec3 uBoxMin;
+uniform vec3 uBoxMax;
+
+void main(){
+    gl_Position = uMVP * vec4(mix(uBoxMin, uBoxMax, aPos), 1.0);
+}
@@ -2,11 +2,22 @@
 
 layout(location=0) in vec3 aPos;
 
-uniform mat4 uViewProj;
+// Per-frame values shared by every program (UniformBuffers::setFrame)
+layout(std140) uniform Frame {
+    mat4 uView;
+    mat4 uProjection;
+    mat4 uViewProj;
+    vec4 light_posn[5];  // Light positions (in eye space)
+    vec4 light_col[5];   // Light colors
+    vec4 uSunDir;
+    vec4 uSunColor;
+    vec4 uAmbient;
+};
 
 out vec3 TexCoords;
 
 void main(){
     TexCoords = aPos;                // unit-sphere position = direction
-    gl_Position = uViewProj * vec4(aPos,1.0);
+    // rotation only, so the sky stays centred on the camera
+    gl_Position = uProjection * mat4(mat3(uView)) * vec4(aPos,1.0);
 }
@@ -18,9 +18,17 @@ uniform float uSnowLine;
 uniform float uBlendW;
 
 // lighting
-uniform vec3 uSunDir;
-uniform vec3 uSunColor;
-uniform vec3 uAmbient;
+// Per-frame values shared by every program (UniformBuffers::setFrame)
+layout(std140) uniform Frame {
+    mat4 uView;
+    mat4 uProjection;
+    mat4 uViewProj;
+    vec4 light_posn[5];  // Light positions (in eye space)
+    vec4 light_col[5];   // Light colors
+    vec4 uSunDir;
+    vec4 uSunColor;
+    vec4 uAmbient;
+};
 
 void main()
 {
@@ -53,10 +61,10 @@ void main()
 
     // lighting: diffuse + simple AO
     vec3 N = normalize(VS_Normal);
-    vec3 L = normalize(-uSunDir);
+    vec3 L = normalize(-uSunDir.xyz);
     float diff = max(dot(N, L), 0.0);
     float ao   = clamp(N.y * 0.5 + 0.5, 0.0, 1.0);
-    vec3 lighting = uAmbient * ao + diff * uSunColor;
+    vec3 lighting = uAmbient.rgb * ao + diff * uSunColor.rgb;
 
     vec3 colour = pow(base * lighting, vec3(1.0 / 2.2));
     FragColor = vec4(colour, 1.0);
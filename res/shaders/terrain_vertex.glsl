@@ -12,7 +12,18 @@ out float VS_Height;
 out float VS_Slope;
 
 uniform mat4  uModel;
-uniform mat4  uViewProj;
+
+// Per-frame values shared by every program (UniformBuffers::setFrame)
+layout(std140) uniform Frame {
+    mat4 uView;
+    mat4 uProjection;
+    mat4 uViewProj;
+    vec4 light_posn[5];  // Light positions (in eye space)
+    vec4 light_col[5];   // Light colors
+    vec4 uSunDir;
+    vec4 uSunColor;
+    vec4 uAmbient;
+};
 
 // height sampling
 uniform sampler2D uHeightTex;
@@ -22,6 +33,10 @@ uniform float     uTexel;      // = 1.0 / heightmapResolution
 // NEW: uv-scaling
 uniform vec2      uUVScale;
 
+// packed vertices: unorm16 positions over the mesh AABB (identity for floats)
+uniform vec3      uPosOffset;
+uniform vec3      uPosScale;
+
 void main()
 {
     // apply the UV scale here:
@@ -29,7 +44,7 @@ void main()
 
     // --- displacement from heightmap ---
     float h = texture(uHeightTex, VS_UV).r * uHeightScale;
-    vec3  p = aPos + vec3(0.0, h, 0.0);
+    vec3  p = uPosOffset + aPos * uPosScale + vec3(0.0, h, 0.0);
     VS_FragPos = vec3(uModel * vec4(p, 1.0));
     VS_Height  = h;
 
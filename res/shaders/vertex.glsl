@@ -4,18 +4,44 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texcoord;
+layout (location = 3) in vec2 tangent; // octahedral, bitangent sign folded into x
 
 // Uniform (Matrix)
 uniform mat4 uMVP;
 
+// Vertex decoding, identity for the float layout:
+// packed positions are unorm16 over the model AABB, normals octahedral snorm16.
+// Tangents are octahedral in both layouts (see VertexLayout::encodeTangent).
+uniform vec3 uPosOffset;
+uniform vec3 uPosScale;
+uniform bool uOctNormals;
+
 // Outputs for the fragment shader
 out vec3 m_normal;
 out vec4 m_vertex;
 out vec2 m_texcoord;
+out vec4 m_tangent;
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+		n.xy = (1.0 - abs(n.yx)) * s;
+	}
+	return normalize(n);
+}
+
+vec4 tangentDecode(vec2 e) {
+	float sign = e.x < 0.0 ? -1.0 : 1.0;
+	float x = (abs(e.x) * 127.0 - 1.0) / 63.0 - 1.0;
+	return vec4(octDecode(vec2(x, e.y)), sign);
+}
 
 void main() {
-	gl_Position = uMVP * vec4(position, 1.0);
-	m_normal = normal;
-	m_vertex = vec4(position, 1.0);
+	vec3 p = uPosOffset + position * uPosScale;
+	gl_Position = uMVP * vec4(p, 1.0);
+	m_normal = uOctNormals ? octDecode(normal.xy) : normal;
+	m_vertex = vec4(p, 1.0);
 	m_texcoord = texcoord;
+	m_tangent = tangentDecode(tangent);
 }
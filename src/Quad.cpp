@@ -1,5 +1,6 @@
 // Quad.cpp
 #include "Quad.h"
+#include "vertex_format.h"
 
 Quad::Quad() = default;
 
@@ -34,6 +35,7 @@ void Quad::setVertexData() {
     float du    = 1.0f / float(n);
     float dv    = 1.0f / float(n);
     glm::vec3 normal(0,1,0);
+    glm::vec4 tangent(1,0,0,-1); // u runs along +x and (unflipped) v along +z
 
     // for each cell in the grid
     for (int i = 0; i < n; ++i) {
@@ -51,25 +53,26 @@ void Quad::setVertexData() {
             glm::vec2 t3(du * i    , 1 - dv * (j+1));
 
             // triangle 1: TL, BL, BR
-            appendVertexData(v0, normal, t0);
-            appendVertexData(v3, normal, t3);
-            appendVertexData(v2, normal, t2);
+            appendVertexData(v0, normal, t0, tangent);
+            appendVertexData(v3, normal, t3, tangent);
+            appendVertexData(v2, normal, t2, tangent);
 
             // triangle 2: BR, TR, TL
-            appendVertexData(v2, normal, t2);
-            appendVertexData(v1, normal, t1);
-            appendVertexData(v0, normal, t0);
+            appendVertexData(v2, normal, t2, tangent);
+            appendVertexData(v1, normal, t1, tangent);
+            appendVertexData(v0, normal, t0, tangent);
         }
     }
 }
 
-void Quad::appendVertexData(const glm::vec3 &p, const glm::vec3 &n, const glm::vec2 &t) {
+void Quad::appendVertexData(const glm::vec3 &p, const glm::vec3 &n, const glm::vec2 &t, const glm::vec4 &tangent) {
     insertVec3(m_vertexData, p);
     m_positions.push_back(p);
     insertVec3(m_vertexData, n);
     m_normals.push_back(n);
     insertVec2(m_vertexData, t);
     m_textureCoords.push_back(t);
+    insertVec2(m_vertexData, gl::VertexLayout::encodeTangent(glm::vec3(tangent), tangent.w));
 }
 
 std::vector<float>& Quad::getData() {
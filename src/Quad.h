@@ -26,7 +26,9 @@ private:
     std::vector<glm::vec2> m_textureCoords;
 
     void setVertexData();
-    void appendVertexData(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoord);
+    // Vertex data is pos(3), normal(3), tex(2), tangent(2), the loader's Float32 layout.
+    void appendVertexData(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoord,
+                          const glm::vec4 &tangent);
     static inline void insertVec3(std::vector<float> &data, const glm::vec3 &v);
     static inline void insertVec2(std::vector<float> &data, const glm::vec2 &v);
 };
@@ -0,0 +1,229 @@
+#include "block_compress.h"
+
+#include <algorithm>
+
+#include "simd.h"
+
+namespace gl {
+
+    namespace {
+        // 4x4 texels as RGBA, clamped at the image edges.
+        struct Block {
+            uint8_t texels[16][4];
+        };
+
+        Block loadBlock(const unsigned char* pixels, int width, int height, int channels, int bx, int by) {
+            Block block;
+            for (int y = 0; y < 4; y++) {
+                int sy = std::min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++) {
+                    int sx = std::min(bx * 4 + x, width - 1);
+                    const unsigned char* p = pixels + (static_cast<size_t>(sy) * width + sx) * channels;
+                    uint8_t* t = block.texels[y * 4 + x];
+                    for (int c = 0; c < 4; c++) {
+                        t[c] = c < channels ? p[c] : (c == 3 ? 255 : 0);
+                    }
+                }
+            }
+            return block;
+        }
+
+        void store16(unsigned char* out, uint16_t v) {
+            out[0] = static_cast<unsigned char>(v & 0xff);
+            out[1] = static_cast<unsigned char>(v >> 8);
+        }
+
+        uint16_t to565(const int c[3]) {
+            return static_cast<uint16_t>(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 |
+                                         ((c[2] * 31 + 127) / 255));
+        }
+
+        void from565(uint16_t v, float out[3]) {
+            int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+            out[0] = static_cast<float>((r << 3) | (r >> 2));
+            out[1] = static_cast<float>((g << 2) | (g >> 4));
+            out[2] = static_cast<float>((b << 3) | (b >> 2));
+        }
+
+        // Nearest of the four palette colors for each texel, 2 bits per texel.
+        uint32_t colorIndices(const Block& block, const float palette[4][3]) {
+            alignas(16) float channel[3][16];
+            for (int i = 0; i < 16; i++) {
+                for (int c = 0; c < 3; c++) channel[c][i] = block.texels[i][c];
+            }
+            uint32_t bits = 0;
+#ifdef GL_SSE2
+            for (int i = 0; i < 16; i += 4) {
+                __m128 r = _mm_load_ps(channel[0] + i);
+                __m128 g = _mm_load_ps(channel[1] + i);
+                __m128 b = _mm_load_ps(channel[2] + i);
+                __m128 best = _mm_set1_ps(1e30f);
+                __m128i index = _mm_setzero_si128();
+                for (int p = 0; p < 4; p++) {
+                    __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+                    __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+                    __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+                    __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+                    __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+                    best = _mm_min_ps(d, best);
+                    index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, index));
+                }
+                alignas(16) int32_t lanes[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), index);
+                for (int k = 0; k < 4; k++) bits |= static_cast<uint32_t>(lanes[k]) << (2 * (i + k));
+            }
+#else
+            for (int i = 0; i < 16; i++) {
+                float best = 1e30f;
+                uint32_t index = 0;
+                for (uint32_t p = 0; p < 4; p++) {
+                    float dr = channel[0][i] - palette[p][0];
+                    float dg = channel[1][i] - palette[p][1];
+                    float db = channel[2][i] - palette[p][2];
+                    float d = dr * dr + dg * dg + db * db;
+                    if (d < best) {
+                        best = d;
+                        index = p;
+                    }
+                }
+                bits |= index << (2 * i);
+            }
+#endif
+            return bits;
+        }
+
+        // BC1 color block in four-color mode.
+        void encodeColor(const Block& block, unsigned char* out) {
+            int lo[3] = {255, 255, 255};
+            int hi[3] = {0, 0, 0};
+            float mean[3] = {0, 0, 0};
+            for (const auto& t : block.texels) {
+                for (int c = 0; c < 3; c++) {
+                    lo[c] = std::min<int>(lo[c], t[c]);
+                    hi[c] = std::max<int>(hi[c], t[c]);
+                    mean[c] += t[c] / 16.0f;
+                }
+            }
+
+            // Take the box diagonal the colors run along: channels that fall while
+            // the widest one rises get their range reversed.
+            int widest = 0;
+            for (int c = 1; c < 3; c++) {
+                if (hi[c] - lo[c] > hi[widest] - lo[widest]) widest = c;
+            }
+            int e0[3], e1[3];
+            for (int c = 0; c < 3; c++) {
+                float covariance = 0.0f;
+                for (const auto& t : block.texels) {
+                    covariance += (t[c] - mean[c]) * (t[widest] - mean[widest]);
+                }
+                // Inset by 1/16 of the extent; the ends of the box are rarely hit.
+                int inset = (hi[c] - lo[c]) >> 4;
+                e0[c] = hi[c] - inset;
+                e1[c] = lo[c] + inset;
+                if (covariance < 0.0f) std::swap(e0[c], e1[c]);
+            }
+
+            uint16_t c0 = to565(e0);
+            uint16_t c1 = to565(e1);
+            if (c0 < c1) std::swap(c0, c1);
+            store16(out, c0);
+            store16(out + 2, c1);
+            uint32_t bits = 0;
+            if (c0 != c1) {
+                float palette[4][3];
+                from565(c0, palette[0]);
+                from565(c1, palette[1]);
+                for (int c = 0; c < 3; c++) {
+                    palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+                    palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+                }
+                bits = colorIndices(block, palette);
+            }
+            for (int i = 0; i < 4; i++) out[4 + i] = static_cast<unsigned char>(bits >> (8 * i));
+        }
+
+        // BC4 block of one channel in eight-value mode.
+        void encodeChannel(const Block& block, int channel, unsigned char* out) {
+            int lo = 255, hi = 0;
+            for (const auto& t : block.texels) {
+                lo = std::min<int>(lo, t[channel]);
+                hi = std::max<int>(hi, t[channel]);
+            }
+            out[0] = static_cast<unsigned char>(hi);
+            out[1] = static_cast<unsigned char>(lo);
+            uint64_t bits = 0;
+            if (hi > lo) {
+                float scale = 7.0f / static_cast<float>(hi - lo);
+                for (int i = 0; i < 16; i++) {
+                    // Step k of 7 from hi to lo; codes 0 and 1 are the endpoints.
+                    int k = static_cast<int>((hi - block.texels[i][channel]) * scale + 0.5f);
+                    uint64_t code = k == 0 ? 0 : (k == 7 ? 1 : k + 1);
+                    bits |= code << (3 * i);
+                }
+            }
+            for (int i = 0; i < 6; i++) out[2 + i] = static_cast<unsigned char>(bits >> (8 * i));
+        }
+
+        size_t blockBytes(BlockFormat format) {
+            switch (format) {
+                case BlockFormat::BC1:
+                case BlockFormat::BC4: return 8;
+                case BlockFormat::BC3:
+                case BlockFormat::BC5: return 16;
+                default: return 0;
+            }
+        }
+    }
+
+    size_t BlockCompress::levelSize(BlockFormat format, int width, int height) {
+        size_t blocksX = static_cast<size_t>(std::max(1, (width + 3) / 4));
+        size_t blocksY = static_cast<size_t>(std::max(1, (height + 3) / 4));
+        return blocksX * blocksY * blockBytes(format);
+    }
+
+    int BlockCompress::channelCount(BlockFormat format) {
+        switch (format) {
+            case BlockFormat::BC1: return 3;
+            case BlockFormat::BC3: return 4;
+            case BlockFormat::BC4: return 1;
+            case BlockFormat::BC5: return 2;
+            default: return 0;
+        }
+    }
+
+    std::vector<unsigned char> BlockCompress::encode(BlockFormat format, const unsigned char* pixels, int width,
+                                                     int height, int channels) {
+        std::vector<unsigned char> out(levelSize(format, width, height));
+        if (out.empty() || !pixels || width <= 0 || height <= 0) return {};
+
+        const int blocksX = (width + 3) / 4;
+        const int blocksY = (height + 3) / 4;
+        const size_t bytes = blockBytes(format);
+        unsigned char* dst = out.data();
+        for (int by = 0; by < blocksY; by++) {
+            for (int bx = 0; bx < blocksX; bx++, dst += bytes) {
+                Block block = loadBlock(pixels, width, height, channels, bx, by);
+                switch (format) {
+                    case BlockFormat::BC1:
+                        encodeColor(block, dst);
+                        break;
+                    case BlockFormat::BC3:
+                        encodeChannel(block, 3, dst);
+                        encodeColor(block, dst + 8);
+                        break;
+                    case BlockFormat::BC4:
+                        encodeChannel(block, 0, dst);
+                        break;
+                    case BlockFormat::BC5:
+                        encodeChannel(block, 0, dst);
+                        encodeChannel(block, 1, dst + 8);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+        return out;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gl {
+
+// GPU block compression formats, 4x4 texels per block.
+enum class BlockFormat : uint32_t {
+    None = 0,
+    BC1, // RGB, 8 bytes per block
+    BC3, // RGBA: BC1 color plus an interpolated alpha block, 16 bytes
+    BC4, // one channel, 8 bytes
+    BC5, // two channels as two BC4 blocks, 16 bytes
+};
+
+// CPU encoder for BC1/BC3/BC4/BC5. Endpoints come from each block's bounding
+// box, inset slightly; color indices are chosen four texels at a time with SSE2.
+class BlockCompress {
+public:
+    // Bytes of one level of width x height texels.
+    static size_t levelSize(BlockFormat format, int width, int height);
+    // Channels a format stores: 3 for BC1, 4 for BC3, 1 for BC4 and 2 for BC5.
+    static int channelCount(BlockFormat format);
+
+    // Encodes an 8-bit image with 1-4 interleaved channels. BC1 and BC3 read
+    // RGB(A), BC4 the first channel and BC5 the first two; missing channels are
+    // read as 0, and alpha as 255.
+    static std::vector<unsigned char> encode(BlockFormat format, const unsigned char* pixels, int width, int height,
+                                             int channels);
+};
+}
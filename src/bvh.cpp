@@ -0,0 +1,218 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace gl {
+
+    namespace {
+        constexpr int kBinCount = 12;
+        constexpr uint32_t kMaxLeafSize = 4;
+        // Cost of visiting an inner node relative to testing one primitive.
+        constexpr float kTraversalCost = 1.0f;
+
+        struct Bin {
+            Aabb bounds;
+            uint32_t count = 0;
+        };
+
+        // Primitives whose centroid falls in a bin below bin go left.
+        struct Split {
+            int axis = -1;
+            int bin = 0;
+            float lo = 0.0f;
+            float scale = 0.0f;
+            float cost = FLT_MAX;
+        };
+
+        glm::vec3 centroid(const Aabb& b) {
+            return 0.5f * (b.bmin + b.bmax);
+        }
+
+        int binOf(const Aabb& b, int axis, float lo, float scale) {
+            return std::clamp(static_cast<int>((centroid(b)[axis] - lo) * scale), 0, kBinCount - 1);
+        }
+
+        // Best binned SAH split of primitives[first, first + count).
+        Split findSplit(const std::vector<Aabb>& boxes, const uint32_t* primitives, uint32_t count) {
+            Aabb centroids;
+            for (uint32_t i = 0; i < count; i++) centroids.grow(centroid(boxes[primitives[i]]));
+
+            Split best;
+            for (int axis = 0; axis < 3; axis++) {
+                float lo = centroids.bmin[axis];
+                float extent = centroids.bmax[axis] - lo;
+                if (!(extent > 0.0f)) continue;
+
+                Bin bins[kBinCount];
+                float scale = kBinCount / extent;
+                for (uint32_t i = 0; i < count; i++) {
+                    const Aabb& b = boxes[primitives[i]];
+                    int bin = binOf(b, axis, lo, scale);
+                    bins[bin].bounds.grow(b);
+                    bins[bin].count++;
+                }
+
+                // Sweep from both sides to get the cost of every plane between bins.
+                float leftArea[kBinCount - 1];
+                uint32_t leftCount[kBinCount - 1];
+                Aabb left;
+                uint32_t n = 0;
+                for (int i = 0; i < kBinCount - 1; i++) {
+                    left.grow(bins[i].bounds);
+                    n += bins[i].count;
+                    leftArea[i] = left.area();
+                    leftCount[i] = n;
+                }
+                Aabb right;
+                n = 0;
+                for (int i = kBinCount - 1; i > 0; i--) {
+                    right.grow(bins[i].bounds);
+                    n += bins[i].count;
+                    if (leftCount[i - 1] == 0 || n == 0) continue;
+                    float cost = leftArea[i - 1] * leftCount[i - 1] + right.area() * n;
+                    if (cost < best.cost) {
+                        best = {axis, i, lo, scale, cost};
+                    }
+                }
+            }
+            return best;
+        }
+
+        bool hitsTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a,
+                          const glm::vec3& b, const glm::vec3& c, float& t) {
+            // Möller-Trumbore, both faces.
+            glm::vec3 e1 = b - a;
+            glm::vec3 e2 = c - a;
+            glm::vec3 p = glm::cross(direction, e2);
+            float det = glm::dot(e1, p);
+            if (std::abs(det) < 1e-12f) return false;
+            float invDet = 1.0f / det;
+            glm::vec3 s = origin - a;
+            float u = glm::dot(s, p) * invDet;
+            if (u < 0.0f || u > 1.0f) return false;
+            glm::vec3 q = glm::cross(s, e1);
+            float v = glm::dot(direction, q) * invDet;
+            if (v < 0.0f || u + v > 1.0f) return false;
+            t = glm::dot(e2, q) * invDet;
+            return t >= 0.0f;
+        }
+    }
+
+    void Bvh::build(std::vector<Aabb> boxes) {
+        m_boxes = std::move(boxes);
+        m_nodes.clear();
+        m_primitives.resize(m_boxes.size());
+        for (uint32_t i = 0; i < m_primitives.size(); i++) m_primitives[i] = i;
+        if (m_boxes.empty()) return;
+
+        m_nodes.reserve(2 * m_boxes.size());
+        m_nodes.push_back({{}, 0, static_cast<uint32_t>(m_boxes.size())});
+        std::vector<uint32_t> pending{0};
+        while (!pending.empty()) {
+            uint32_t index = pending.back();
+            pending.pop_back();
+
+            Node node = m_nodes[index];
+            uint32_t* primitives = m_primitives.data() + node.first;
+            for (uint32_t i = 0; i < node.count; i++) node.bounds.grow(m_boxes[primitives[i]]);
+            m_nodes[index].bounds = node.bounds;
+            if (node.count <= 1) continue;
+
+            Split split = findSplit(m_boxes, primitives, node.count);
+            float leafCost = static_cast<float>(node.count);
+            float splitCost = kTraversalCost + split.cost / std::max(node.bounds.area(), 1e-30f);
+            uint32_t leftCount = 0;
+            if (split.axis >= 0 && (splitCost < leafCost || node.count > kMaxLeafSize)) {
+                uint32_t* mid = std::partition(primitives, primitives + node.count, [&](uint32_t p) {
+                    return binOf(m_boxes[p], split.axis, split.lo, split.scale) < split.bin;
+                });
+                leftCount = static_cast<uint32_t>(mid - primitives);
+            } else if (node.count > kMaxLeafSize) {
+                // Coincident centroids: no plane separates them, halve the range.
+                leftCount = node.count / 2;
+            }
+            if (leftCount == 0 || leftCount == node.count) continue;
+
+            auto child = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back({{}, node.first, leftCount});
+            m_nodes.push_back({{}, node.first + leftCount, node.count - leftCount});
+            m_nodes[index].first = child;
+            m_nodes[index].count = 0;
+            pending.push_back(child);
+            pending.push_back(child + 1);
+        }
+    }
+
+    void Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+        if (m_nodes.empty()) return;
+
+        // A node entirely inside the frustum takes its whole subtree without tests.
+        struct Entry {
+            uint32_t node;
+            bool inside;
+        };
+        std::vector<Entry> stack{{0, false}};
+        while (!stack.empty()) {
+            Entry e = stack.back();
+            stack.pop_back();
+            const Node& node = m_nodes[e.node];
+            bool inside = e.inside;
+            if (!inside) {
+                Frustum::Test test = frustum.classify(node.bounds.bmin, node.bounds.bmax);
+                if (test == Frustum::Test::Outside) continue;
+                inside = test == Frustum::Test::Inside;
+            }
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    uint32_t p = m_primitives[i];
+                    if (inside || frustum.intersects(m_boxes[p].bmin, m_boxes[p].bmax)) {
+                        visible.push_back(p);
+                    }
+                }
+                continue;
+            }
+            stack.push_back({node.first + 1, inside});
+            stack.push_back({node.first, inside});
+        }
+    }
+
+    bool Bvh::hitsBox(const Aabb& box, const glm::vec3& origin, const glm::vec3& invDirection, float tMax,
+                      float& tEnter) {
+        glm::vec3 t0 = (box.bmin - origin) * invDirection;
+        glm::vec3 t1 = (box.bmax - origin) * invDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        tEnter = std::max({tNear.x, tNear.y, tNear.z, 0.0f});
+        float tExit = std::min({tFar.x, tFar.y, tFar.z, tMax});
+        return tEnter <= tExit;
+    }
+
+    MeshBvh::MeshBvh(const float* vertices, size_t vertexCount, size_t stride, std::vector<uint32_t> indices)
+            : m_indices(std::move(indices)) {
+        m_positions.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            m_positions[i] = glm::vec3(vertices[i * stride], vertices[i * stride + 1], vertices[i * stride + 2]);
+        }
+        std::vector<Aabb> boxes(m_indices.size() / 3);
+        for (size_t t = 0; t < boxes.size(); t++) {
+            for (int k = 0; k < 3; k++) boxes[t].grow(m_positions[m_indices[3 * t + k]]);
+        }
+        m_bvh.build(std::move(boxes));
+    }
+
+    bool MeshBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float& tMax,
+                          uint32_t& triangle) const {
+        return m_bvh.raycast(origin, direction, tMax, [&](uint32_t t, float& closest) {
+            float distance;
+            if (!hitsTriangle(origin, direction, m_positions[m_indices[3 * t]], m_positions[m_indices[3 * t + 1]],
+                              m_positions[m_indices[3 * t + 2]], distance) || distance > closest) {
+                return false;
+            }
+            closest = distance;
+            triangle = t;
+            return true;
+        });
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.h"
+
+namespace gl {
+
+struct Aabb {
+    glm::vec3 bmin{FLT_MAX};
+    glm::vec3 bmax{-FLT_MAX};
+
+    void grow(const glm::vec3& p) {
+        bmin = glm::min(bmin, p);
+        bmax = glm::max(bmax, p);
+    }
+    void grow(const Aabb& b) {
+        bmin = glm::min(bmin, b.bmin);
+        bmax = glm::max(bmax, b.bmax);
+    }
+    [[nodiscard]] float area() const {
+        glm::vec3 e = glm::max(bmax - bmin, glm::vec3(0.0f));
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+};
+
+// Bounding volume hierarchy over a set of boxes, built top-down with binned
+// SAH. Primitives are referred to by their index in the boxes passed to build.
+class Bvh {
+public:
+    // Inner nodes have count 0 and children first and first + 1; leaves cover
+    // primitives()[first, first + count).
+    struct Node {
+        Aabb bounds;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    void build(std::vector<Aabb> boxes);
+
+    // Appends the primitives whose box intersects the frustum.
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    // Closest hit along origin + t * direction for t in [0, tMax]. hit(primitive,
+    // tMax) tests one primitive and lowers tMax on a closer hit, returning true.
+    template <class HitFn>
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float& tMax, HitFn&& hit) const;
+
+    [[nodiscard]] size_t size() const { return m_boxes.size(); }
+    [[nodiscard]] bool empty() const { return m_nodes.empty(); }
+    [[nodiscard]] const std::vector<uint32_t>& primitives() const { return m_primitives; }
+
+private:
+    static bool hitsBox(const Aabb& box, const glm::vec3& origin, const glm::vec3& invDirection, float tMax,
+                        float& tEnter);
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_primitives;
+    std::vector<Aabb> m_boxes;
+};
+
+// Triangle-level hierarchy of one DrawObject for ray queries, with its own copy
+// of the full-detail positions and triangles.
+class MeshBvh {
+public:
+    MeshBvh(const float* vertices, size_t vertexCount, size_t stride, std::vector<uint32_t> indices);
+
+    // Closest triangle hit within tMax; lowers tMax and sets triangle on a hit.
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float& tMax, uint32_t& triangle) const;
+
+private:
+    std::vector<glm::vec3> m_positions;
+    std::vector<uint32_t> m_indices;
+    Bvh m_bvh;
+};
+
+template <class HitFn>
+bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float& tMax, HitFn&& hit) const {
+    if (m_nodes.empty()) return false;
+
+    const glm::vec3 invDirection = 1.0f / direction;
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    bool found = false;
+    float tEnter;
+    while (!stack.empty()) {
+        const Node& node = m_nodes[stack.back()];
+        stack.pop_back();
+        if (!hitsBox(node.bounds, origin, invDirection, tMax, tEnter)) continue;
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                found |= hit(m_primitives[i], tMax);
+            }
+            continue;
+        }
+        // Visit the nearer child first so the far one is often rejected.
+        float tLeft = FLT_MAX;
+        float tRight = FLT_MAX;
+        bool left = hitsBox(m_nodes[node.first].bounds, origin, invDirection, tMax, tLeft);
+        bool right = hitsBox(m_nodes[node.first + 1].bounds, origin, invDirection, tMax, tRight);
+        if (left && right) {
+            stack.push_back(tLeft < tRight ? node.first + 1 : node.first);
+            stack.push_back(tLeft < tRight ? node.first : node.first + 1);
+        } else if (left) {
+            stack.push_back(node.first);
+        } else if (right) {
+            stack.push_back(node.first + 1);
+        }
+    }
+    return found;
+}
+}
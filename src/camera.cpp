@@ -42,6 +42,14 @@ namespace gl {
         return Camera::position;
     }
 
+    void Camera::set_position(const glm::vec3& p) {
+        Camera::position = p;
+    }
+
+    glm::vec3 Camera::get_front() {
+        return Camera::front;
+    }
+
     glm::vec3 Camera::get_rotation() {
         return Camera::rotation;
     }
@@ -12,6 +12,8 @@ namespace gl {
         static void reset_camera();
         static void move(glm::vec3 direction, float velocity);
         static glm::vec3 get_position();
+        static void set_position(const glm::vec3& p);
+        static glm::vec3 get_front();
         static glm::vec3 get_rotation();
         static void processMouse(double xpos, double ypos, bool constrainPitch = false);
         static void processScroll(double yoffset);
@@ -0,0 +1,103 @@
+#include "draw_list.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace gl {
+
+    namespace {
+        // key: pass(1), then state(26) and depth(20), depth first for transparent draws.
+        constexpr int kPassShift = DrawList::key_bits - 1;
+        constexpr int kDepthBits = 20;
+        constexpr int kStateBits = 26;
+        constexpr uint64_t kDepthMask = (uint64_t(1) << kDepthBits) - 1;
+
+        // Sort entries hold the key above a 17-bit record index.
+        constexpr int kIndexBits = 64 - DrawList::key_bits;
+        constexpr uint64_t kIndexMask = (uint64_t(1) << kIndexBits) - 1;
+        constexpr int kDigitBits = 8;
+        constexpr int kDigits = (DrawList::key_bits + kDigitBits - 1) / kDigitBits;
+        constexpr size_t kRadix = size_t(1) << kDigitBits;
+
+        // Top bits of a non-negative float, whose bit patterns order like the
+        // values, so no far plane is needed to quantize.
+        uint64_t depthKey(float depth) {
+            if (!(depth > 0.0f)) return 0;
+            uint32_t bits;
+            std::memcpy(&bits, &depth, sizeof(bits));
+            return bits >> (32 - 1 - kDepthBits);
+        }
+
+        // Stable least-significant-digit radix sort of entries by keyOf(entry),
+        // with the histograms of all digits gathered in one pass.
+        template <typename Entry, typename KeyOf>
+        void radixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch, KeyOf keyOf) {
+            const size_t count = entries.size();
+            size_t histograms[kDigits][kRadix] = {};
+            for (const Entry& entry : entries) {
+                const uint64_t key = keyOf(entry);
+                for (int digit = 0; digit < kDigits; digit++) {
+                    histograms[digit][(key >> (kDigitBits * digit)) & (kRadix - 1)]++;
+                }
+            }
+
+            for (int digit = 0; digit < kDigits; digit++) {
+                const int shift = kDigitBits * digit;
+                size_t* histogram = histograms[digit];
+                // Every key shares this digit: the pass would not move anything.
+                if (count == 0 || histogram[(keyOf(entries[0]) >> shift) & (kRadix - 1)] == count) continue;
+                size_t offset = 0;
+                for (size_t value = 0; value < kRadix; value++) {
+                    size_t n = histogram[value];
+                    histogram[value] = offset;
+                    offset += n;
+                }
+                for (const Entry& entry : entries) {
+                    scratch[histogram[(keyOf(entry) >> shift) & (kRadix - 1)]++] = entry;
+                }
+                entries.swap(scratch);
+            }
+        }
+    }
+
+    uint64_t DrawList::key(DrawPass pass, uint32_t program, uint32_t model, uint32_t material, GLenum indexType,
+                           float depth) {
+        // program(4) model(9) material(12) 32-bit indices(1)
+        const uint64_t state = (uint64_t(program & 0xf) << 22) | (uint64_t(model & 0x1ff) << 13)
+                               | (uint64_t(material & 0xfff) << 1) | (indexType == GL_UNSIGNED_INT ? 1 : 0);
+        const uint64_t depthBits = depthKey(depth);
+        if (pass == DrawPass::Opaque) {
+            return (uint64_t(pass) << kPassShift) | (state << kDepthBits) | depthBits;
+        }
+        return (uint64_t(pass) << kPassShift) | ((kDepthMask - depthBits) << kStateBits) | state;
+    }
+
+    void DrawList::clear() {
+        m_records.clear();
+        m_order.clear();
+        m_wideOrder.clear();
+    }
+
+    void DrawList::sort() {
+        const size_t count = m_records.size();
+        m_order.clear();
+        m_wideOrder.clear();
+        if (count > kIndexMask + 1) {
+            // Too many records to pack their index next to the key.
+            m_wideOrder.resize(count);
+            m_wideScratch.resize(count);
+            for (size_t i = 0; i < count; i++) m_wideOrder[i] = {m_records[i].key, static_cast<uint32_t>(i)};
+            radixSort(m_wideOrder, m_wideScratch, [](const WideEntry& e) { return e.key; });
+            return;
+        }
+        m_order.resize(count);
+        m_scratch.resize(count);
+        for (size_t i = 0; i < count; i++) m_order[i] = m_records[i].key << kIndexBits | i;
+        radixSort(m_order, m_scratch, [](uint64_t e) { return e >> kIndexBits; });
+    }
+
+    const DrawRecord& DrawList::operator[](size_t i) const {
+        if (!m_wideOrder.empty()) return m_records[m_wideOrder[i].record];
+        return m_records[m_order[i] & kIndexMask];
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+namespace gl {
+
+// Order of the passes a frame's draws fall in, highest bit of the sort key.
+enum class DrawPass : uint64_t {
+    Opaque = 0,
+    Transparent = 1,
+};
+
+// One draw call's worth of a sub-mesh range, or a whole non-indexed object
+// when indexType is GL_NONE.
+struct DrawRecord {
+    uint64_t key = 0;
+    uint32_t model = 0;    // index into the submitting frame's models
+    uint32_t material = 0; // index into that model's DataTex::materials
+    GLuint vao = 0;
+    GLenum indexType = GL_NONE;
+    GLsizei count = 0;     // indices, or vertices for non-indexed draws
+    const void* offset = nullptr;
+    GLint baseVertex = 0;
+};
+
+// A frame's draw records, sorted by key so state changes happen as rarely as
+// the passes allow. Opaque draws group by program, model (its textures and
+// vertex decoding) and material and go front to back within each group;
+// transparent ones go back to front first and group only among equal depths.
+// Keys take key_bits bits; fields wider than theirs wrap, which only costs
+// batching.
+class DrawList {
+public:
+    static constexpr int key_bits = 47;
+
+    static uint64_t key(DrawPass pass, uint32_t program, uint32_t model, uint32_t material, GLenum indexType,
+                        float depth);
+    static DrawPass pass(uint64_t key) { return static_cast<DrawPass>(key >> (key_bits - 1)); }
+
+    void clear();
+    void add(const DrawRecord& record) { m_records.push_back(record); }
+    // Orders the records by key with a least-significant-digit radix sort over
+    // key and record index packed into one word, skipping the digits every key
+    // shares.
+    void sort();
+
+    [[nodiscard]] size_t size() const { return m_records.size(); }
+    // The i-th record in key order; valid from sort() until the next add().
+    [[nodiscard]] const DrawRecord& operator[](size_t i) const;
+
+private:
+    struct WideEntry {
+        uint64_t key;
+        uint32_t record;
+    };
+
+    std::vector<DrawRecord> m_records;
+    std::vector<uint64_t> m_order; // key above the record index, sorted
+    std::vector<uint64_t> m_scratch;
+    // Used instead for lists too long to pack the index.
+    std::vector<WideEntry> m_wideOrder;
+    std::vector<WideEntry> m_wideScratch;
+};
+}
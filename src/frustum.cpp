@@ -0,0 +1,93 @@
+#include "frustum.h"
+
+#include "simd.h"
+
+namespace gl {
+
+    void SphereBounds::push(const glm::vec3& center, float r) {
+        x.push_back(center.x);
+        y.push_back(center.y);
+        z.push_back(center.z);
+        radius.push_back(r);
+    }
+
+    Frustum::Frustum(const glm::mat4& m) {
+        // Gribb-Hartmann: each plane is the last row of the matrix plus or minus
+        // one of the others (glm is column-major, so row i is m[*][i]).
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        }
+        for (int i = 0; i < 3; i++) {
+            planes[2 * i] = rows[3] + rows[i];
+            planes[2 * i + 1] = rows[3] - rows[i];
+        }
+        for (glm::vec4& p : planes) {
+            float length = glm::length(glm::vec3(p));
+            if (length > 0.0f) p /= length;
+        }
+    }
+
+    size_t Frustum::cullSpheres(const SphereBounds& spheres, uint8_t* visible) const {
+        const size_t count = spheres.size();
+        size_t i = 0;
+        size_t visibleCount = 0;
+#ifdef GL_SSE2
+        // Four spheres at a time against each plane: inside unless some plane has
+        // dot(plane, center) < -radius.
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(&spheres.x[i]);
+            __m128 y = _mm_loadu_ps(&spheres.y[i]);
+            __m128 z = _mm_loadu_ps(&spheres.z[i]);
+            __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const glm::vec4& p : planes) {
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(p.x)), _mm_mul_ps(y, _mm_set1_ps(p.y))),
+                                      _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(p.z)), _mm_set1_ps(p.w)));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negRadius));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (int k = 0; k < 4; k++) {
+                visible[i + k] = static_cast<uint8_t>((mask >> k) & 1);
+                visibleCount += visible[i + k];
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            bool inside = true;
+            for (const glm::vec4& p : planes) {
+                float d = p.x * spheres.x[i] + p.y * spheres.y[i] + p.z * spheres.z[i] + p.w;
+                inside = inside && d >= -spheres.radius[i];
+            }
+            visible[i] = inside ? 1 : 0;
+            visibleCount += visible[i];
+        }
+        return visibleCount;
+    }
+
+    bool Frustum::intersects(const glm::vec3& bmin, const glm::vec3& bmax) const {
+        // The box is outside if its corner furthest along a plane's normal is behind it.
+        for (const glm::vec4& p : planes) {
+            glm::vec3 corner(p.x >= 0.0f ? bmax.x : bmin.x,
+                             p.y >= 0.0f ? bmax.y : bmin.y,
+                             p.z >= 0.0f ? bmax.z : bmin.z);
+            if (glm::dot(glm::vec3(p), corner) + p.w < 0.0f) return false;
+        }
+        return true;
+    }
+
+    Frustum::Test Frustum::classify(const glm::vec3& bmin, const glm::vec3& bmax) const {
+        // Inside needs the nearest corner in front of every plane as well.
+        Test result = Test::Inside;
+        for (const glm::vec4& p : planes) {
+            glm::vec3 n(p);
+            glm::vec3 furthest(p.x >= 0.0f ? bmax.x : bmin.x, p.y >= 0.0f ? bmax.y : bmin.y,
+                               p.z >= 0.0f ? bmax.z : bmin.z);
+            if (glm::dot(n, furthest) + p.w < 0.0f) return Test::Outside;
+            glm::vec3 nearest(p.x >= 0.0f ? bmin.x : bmax.x, p.y >= 0.0f ? bmin.y : bmax.y,
+                              p.z >= 0.0f ? bmin.z : bmax.z);
+            if (glm::dot(n, nearest) + p.w < 0.0f) result = Test::Intersecting;
+        }
+        return result;
+    }
+}
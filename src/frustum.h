@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace gl {
+
+// Bounding spheres of a model's objects in structure-of-arrays layout, so the
+// culling loop can test several objects per SIMD instruction.
+struct SphereBounds {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    void push(const glm::vec3& center, float r);
+    [[nodiscard]] size_t size() const { return radius.size(); }
+};
+
+// The six clip planes of a (model-)view-projection matrix, pointing inwards
+// and normalized, so tests happen in the space the matrix transforms from.
+class Frustum {
+public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    // visible[i] is set to 1 if sphere i intersects the frustum, 0 otherwise.
+    // Returns the number of visible spheres.
+    size_t cullSpheres(const SphereBounds& spheres, uint8_t* visible) const;
+    [[nodiscard]] bool intersects(const glm::vec3& bmin, const glm::vec3& bmax) const;
+
+    enum class Test { Outside, Intersecting, Inside };
+    [[nodiscard]] Test classify(const glm::vec3& bmin, const glm::vec3& bmax) const;
+
+    std::array<glm::vec4, 6> planes{}; // left, right, bottom, top, near, far
+};
+}
@@ -1,4 +1,5 @@
 #include "window.h"
+#include "texture_streamer.h"
 
 int main(int argc, char *argv[])
 {
@@ -6,9 +7,18 @@ int main(int argc, char *argv[])
     // Check command line arguments
     if (argc < 2)
     {
-        std::cout << "Usage: viewer [filename.obj]" << std::endl;
+        std::cout << "Usage: viewer [filename.obj] [--packed] [--optimize] [--lods] [--compress] [--stream]" << std::endl;
         return 0;
     }
+    for (int i = 2; i < argc; i++)
+    {
+        std::string flag = argv[i];
+        if (flag == "--packed") gl::Window::packed_vertices = true;
+        if (flag == "--optimize") gl::Window::optimize_meshes = true;
+        if (flag == "--lods") gl::Window::generate_lods = true;
+        if (flag == "--compress") gl::Window::compress_textures = true;
+        if (flag == "--stream") gl::TextureStreamer::settings.enabled = true;
+    }
 
     gl::Window::initialize(argv[1]);
 
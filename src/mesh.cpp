@@ -1,248 +1,927 @@
-#include <memory>
-#include <iostream>
-
-#include "mesh.h"
-#include "transform.h"
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#define TINYOBJLOADER_USE_MAPBOX_EARCUT
-#include "tiny_obj_loader.h"
-#include "glm/gtc/type_ptr.hpp"
-
-namespace gl {
-
-    std::vector<tinyobj::material_t> materials;
-
-    void Mesh::check_errors(const std::string& desc) {
-        GLenum error;
-        while ((error = glGetError()) != GL_NO_ERROR) {
-            std::cerr << std::format("OpenGL error in \"{}\": {} (0x{:X})\n", desc, error, error);
-        }
-        if (error != GL_NO_ERROR) {
-            std::exit(20);
-        }
-    }
-
-    DataTex Mesh::load_obj(const std::string &filename) {
-
-        tinyobj::ObjReaderConfig config;
-        config.triangulation_method = "earcut";
-        config.triangulate = true;
-        config.vertex_color = false;
-
-        auto data = DataTex();
-        // Each vertex is 8 floats: pos(3), normal(3), tex(2)
-        GLsizei stride = (3 + 3 + 2) * sizeof(float);
-        tinyobj::ObjReader reader;
-        if (!reader.ParseFromFile(filename, config)) {
-            if (!reader.Error().empty()) {
-                std::cerr << "TinyObjReader Error: " << reader.Error() << '\n';
-            }
-            return {};
-        }
-
-        if (!reader.Warning().empty()) {
-            std::cout << "TinyObjReader Warning: " << reader.Warning() << '\n';
-        }
-
-        auto& inattrib = reader.GetAttrib();
-        auto& inshapes = reader.GetShapes();
-        materials = reader.GetMaterials();
-
-        // Append a default material
-        materials.emplace_back();
-
-        // Load textures
-//        for (const tinyobj::material_t& mat : materials) {
-//            if(!mat.ambient_texname.empty()) load_texture(filename, mat.ambient_texname, data);
-//            if(!mat.diffuse_texname.empty()) load_texture(filename, mat.diffuse_texname, data);
-//            if(!mat.specular_texname.empty()) load_texture(filename, mat.specular_texname, data);
-//            if(!mat.specular_highlight_texname.empty()) load_texture(filename, mat.specular_highlight_texname, data);
-//            if(!mat.alpha_texname.empty()) load_texture(filename, mat.alpha_texname, data);
-//            if(!mat.bump_texname.empty()) load_texture(filename, mat.bump_texname, data);
-//            if(!mat.reflection_texname.empty()) load_texture(filename, mat.reflection_texname, data);
-//        }
-        std::string materialFilename = filename;
-        Texture::LoadMaterials(materials, materialFilename, data);
-
-        glm::vec3 bmin(FLT_MAX);
-        glm::vec3 bmax(-FLT_MAX);
-
-        for (int s = 0; s < inshapes.size(); s++) {
-            DrawObject o{};
-            std::vector<float> buffer;  // pos(3), normal(3), tex(2)
-
-            for (size_t f = 0; f < inshapes[s].mesh.indices.size() / 3; f++) {
-                tinyobj::index_t idx0 = inshapes[s].mesh.indices[3 * f + 0];
-                tinyobj::index_t idx1 = inshapes[s].mesh.indices[3 * f + 1];
-                tinyobj::index_t idx2 = inshapes[s].mesh.indices[3 * f + 2];
-
-                int current_material_id = inshapes[s].mesh.material_ids[f];
-                if ((current_material_id < 0) ||
-                    (current_material_id >= static_cast<int>(materials.size()))) {
-                    current_material_id = static_cast<int>(materials.size()) - 1;
-                }
-
-                o.ambient = {
-                        materials[current_material_id].ambient[0],
-                        materials[current_material_id].ambient[1],
-                        materials[current_material_id].ambient[2]
-                };
-                o.diffuse = {
-                        materials[current_material_id].diffuse[0],
-                        materials[current_material_id].diffuse[1],
-                        materials[current_material_id].diffuse[2]
-                };
-                o.specular = {
-                        materials[current_material_id].specular[0],
-                        materials[current_material_id].specular[1],
-                        materials[current_material_id].specular[2]
-                };
-                o.transmittance = {
-                        materials[current_material_id].transmittance[0],
-                        materials[current_material_id].transmittance[1],
-                        materials[current_material_id].transmittance[2]
-                };
-                o.emission = {
-                        materials[current_material_id].emission[0],
-                        materials[current_material_id].emission[1],
-                        materials[current_material_id].emission[2]
-                };
-                o.shininess = materials[current_material_id].shininess;
-                o.ior = materials[current_material_id].ior;
-                o.dissolve = materials[current_material_id].dissolve;
-                o.illum = materials[current_material_id].illum;
-
-                glm::mat3x2 tc(0.0f);
-                if (!inattrib.texcoords.empty() && ((idx0.texcoord_index >= 0) ||
-                                                    (idx1.texcoord_index >= 0) ||
-                                                    (idx2.texcoord_index >= 0))) {
-                    tc[0][0] = inattrib.texcoords[2 * idx0.texcoord_index];
-                    tc[0][1] = 1.0f - inattrib.texcoords[2 * idx0.texcoord_index + 1];
-                    tc[1][0] = inattrib.texcoords[2 * idx1.texcoord_index];
-                    tc[1][1] = 1.0f - inattrib.texcoords[2 * idx1.texcoord_index + 1];
-                    tc[2][0] = inattrib.texcoords[2 * idx2.texcoord_index];
-                    tc[2][1] = 1.0f - inattrib.texcoords[2 * idx2.texcoord_index + 1];
-                }
-
-                glm::mat3 v(0.0f);
-                for (int k = 0; k < 3; k++) {
-                    int f0 = idx0.vertex_index;
-                    int f1 = idx1.vertex_index;
-                    int f2 = idx2.vertex_index;
-                    v[0][k] = inattrib.vertices[3 * f0 + k];
-                    v[1][k] = inattrib.vertices[3 * f1 + k];
-                    v[2][k] = inattrib.vertices[3 * f2 + k];
-
-                    bmin[k] = std::min({bmin[k], v[0][k], v[1][k], v[2][k]});
-                    bmax[k] = std::max({bmax[k], v[0][k], v[1][k], v[2][k]});
-                }
-
-                glm::mat3 n(0.0f);
-                if (!inattrib.normals.empty()) {
-                    int nf0 = idx0.normal_index;
-                    int nf1 = idx1.normal_index;
-                    int nf2 = idx2.normal_index;
-                    if ((nf0 >= 0) || (nf1 >= 0) || (nf2 >= 0)) {
-                        for (int k = 0; k < 3; k++) {
-                            n[0][k] = inattrib.normals[3 * nf0 + k];
-                            n[1][k] = inattrib.normals[3 * nf1 + k];
-                            n[2][k] = inattrib.normals[3 * nf2 + k];
-                        }
-                    }
-                }
-
-                // Store vertex data: position(3), normal(3), texcoords(2)
-                for (int k = 0; k < 3; k++) {
-                    buffer.insert(buffer.end(), {
-                            v[k][0], v[k][1], v[k][2],
-                            n[k][0], n[k][1], n[k][2],
-                            tc[k][0], tc[k][1]
-                    });
-                }
-            }
-
-            if (!inshapes[s].mesh.material_ids.empty()
-                && inshapes[s].mesh.material_ids.size() > s) {
-                // Use material ID of the first face
-                o.material_id = inshapes[s].mesh.material_ids[0];
-            } else {
-                // = ID for default material.
-                o.material_id = materials.size() - 1;
-            }
-
-            if (o.material_id < materials.size()) {
-                tinyobj::material_t mat = materials[o.material_id];
-                o.texNames.ambient_texname = mat.ambient_texname;
-                o.texNames.diffuse_texname = mat.diffuse_texname;
-                o.texNames.specular_texname = mat.specular_texname;
-                o.texNames.specular_highlight_texname = mat.specular_highlight_texname;
-                o.texNames.bump_texname = mat.bump_texname;
-                o.texNames.alpha_texname = mat.alpha_texname;
-                o.texNames.reflection_texname = mat.reflection_texname;
-            }
-
-            if (!buffer.empty()) {
-                GLuint vao;
-                GLuint vbo;
-                glGenVertexArrays(1, &vao);
-                glBindVertexArray(vao);
-                glGenBuffers(1, &vbo);
-                glBindBuffer(GL_ARRAY_BUFFER, vbo);
-                glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(float), buffer.data(), GL_STATIC_DRAW);
-
-                glEnableVertexAttribArray(0); // pos
-                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-
-                glEnableVertexAttribArray(1); // normal
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-
-                glEnableVertexAttribArray(2); // texcoord
-                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-
-                glBindVertexArray(0);
-                o.material_size = materials.size();
-                o.vao = vao;
-                o.vbo = vbo;
-                o.numTriangles = buffer.size() / (3 + 3 + 2) / 3;
-                o.bmin = bmin;
-                o.bmax = bmax;
-            }
-
-            data.m_draw_objects.push_back(o);
-        }
-        materials.clear();
-        return data;
-    }
-
-    void Mesh::draw(GLenum face, GLenum type, GLuint programID, DataTex& data) {
-        glUseProgram(programID);
-        glPolygonMode(face, type);
-        glEnable(GL_POLYGON_OFFSET_FILL);
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glPolygonOffset(1.0, 1.0);
-        for (auto const& o : data.m_draw_objects) {
-            glBindVertexArray(o.vao);
-            // Bind texture if valid
-            if (o.material_id < o.material_size) {
-
-                Texture::BindMaterialTextures(o.texNames, programID, data);
-            }
-
-            glUniform3fv(glGetUniformLocation(programID, "ambient"), 1, glm::value_ptr(o.ambient));
-            glUniform3fv(glGetUniformLocation(programID, "diffuse"),  1, glm::value_ptr(o.diffuse));
-            glUniform3fv(glGetUniformLocation(programID, "specular"), 1, glm::value_ptr(o.specular));
-            glUniform3fv(glGetUniformLocation(programID, "transmittance"), 1, glm::value_ptr(o.transmittance));
-            glUniform3fv(glGetUniformLocation(programID, "emission"), 1, glm::value_ptr(o.emission));
-            glUniform1fv(glGetUniformLocation(programID, "shininess"), 1, &o.shininess);
-            glUniform1fv(glGetUniformLocation(programID, "ior"), 1, &o.ior);
-            glUniform1fv(glGetUniformLocation(programID, "dissolve"), 1, &o.dissolve);
-            glUniform1i(glGetUniformLocation(programID, "illum"), o.illum);
-
-            glDrawArrays(GL_TRIANGLES, 0, 3 * o.numTriangles);
-            glBindVertexArray(0);
-        }
-    }
-}
\ No newline at end of file
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <iostream>
+#include <thread>
+#include <tuple>
+
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplify.h"
+#include "mesh_tangents.h"
+#include "camera.h"
+#include "draw_list.h"
+#include "occlusion.h"
+#include "render_state.h"
+#include "scene_buffer.h"
+#include "shaders.h"
+#include "texture_streamer.h"
+#include "transform.h"
+#include "uniform_buffers.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#define TINYOBJLOADER_USE_MAPBOX_EARCUT
+#include "tiny_obj_loader.h"
+#include "glm/gtc/type_ptr.hpp"
+
+namespace gl {
+
+    namespace {
+        // Open-addressing map from an OBJ (vertex, normal, texcoord) index triple
+        // to the slot of the vertex already emitted for it.
+        class VertexDedup {
+        public:
+            explicit VertexDedup(size_t maxEntries) {
+                size_t capacity = 16;
+                while (capacity < maxEntries * 2) capacity <<= 1;
+                m_mask = capacity - 1;
+                m_keys.resize(capacity);
+                m_slots.assign(capacity, kEmpty);
+            }
+
+            // Returns the slot stored for idx, inserting `next` if it was not present.
+            std::pair<uint32_t, bool> insert(const tinyobj::index_t& idx, uint32_t next) {
+                for (size_t i = hash(idx) & m_mask;; i = (i + 1) & m_mask) {
+                    if (m_slots[i] == kEmpty) {
+                        m_keys[i] = idx;
+                        m_slots[i] = next;
+                        return {next, true};
+                    }
+                    const tinyobj::index_t& key = m_keys[i];
+                    if (key.vertex_index == idx.vertex_index && key.normal_index == idx.normal_index
+                        && key.texcoord_index == idx.texcoord_index) {
+                        return {m_slots[i], false};
+                    }
+                }
+            }
+
+        private:
+            static constexpr uint32_t kEmpty = UINT32_MAX;
+
+            static size_t hash(const tinyobj::index_t& idx) {
+                uint64_t h = static_cast<uint32_t>(idx.vertex_index);
+                h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(idx.normal_index);
+                h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(idx.texcoord_index);
+                h ^= h >> 29;
+                h *= 0xBF58476D1CE4E5B9ull;
+                return static_cast<size_t>(h ^ (h >> 32));
+            }
+
+            size_t m_mask = 0;
+            std::vector<tinyobj::index_t> m_keys;
+            std::vector<uint32_t> m_slots;
+        };
+
+        constexpr size_t kVertexFloats = VertexLayout::floats_per_vertex;
+
+        glm::vec3 positionOf(const ObjectGeometry& g, size_t v) {
+            const float* p = g.vertices.data() + kVertexFloats * v;
+            return {p[0], p[1], p[2]};
+        }
+
+        constexpr int kLodLevels = 3;
+        constexpr float kLodMaxError = 0.05f; // fraction of the shape's diagonal
+        constexpr float kLodPixelError = 1.0f;
+
+        // Appends up to kLodLevels coarser index sets to g, each halving the
+        // previous level per sub-mesh, until simplification stops paying off.
+        void generateLods(ObjectGeometry& g) {
+            size_t vertexCount = g.vertices.size() / kVertexFloats;
+            glm::vec3 lo(FLT_MAX);
+            glm::vec3 hi(-FLT_MAX);
+            for (size_t v = 0; v < vertexCount; v++) {
+                glm::vec3 p = positionOf(g, v);
+                lo = glm::min(lo, p);
+                hi = glm::max(hi, p);
+            }
+            float maxError = kLodMaxError * glm::length(hi - lo);
+
+            std::vector<uint32_t> scratch;
+            float previousError = 0.0f;
+            for (int level = 0; level < kLodLevels; level++) {
+                const std::vector<SubMesh>& previous = g.object.lods.empty() ? g.object.subMeshes
+                                                                            : g.object.lods.back().subMeshes;
+                size_t start = g.indices.size();
+                size_t before = 0;
+                MeshLod lod;
+                for (const SubMesh& sm : previous) {
+                    scratch.resize(sm.numIndices);
+                    float error = 0.0f;
+                    size_t count = MeshSimplifier::simplify(scratch.data(), g.indices.data() + sm.firstIndex,
+                                                            sm.numIndices, g.vertices.data(), vertexCount, kVertexFloats,
+                                                            sm.numIndices / 6 * 3, maxError, &error);
+                    before += sm.numIndices;
+                    lod.error = std::max(lod.error, error);
+                    if (count == 0) continue;
+                    lod.subMeshes.push_back({g.indices.size(), count, sm.material_id});
+                    g.indices.insert(g.indices.end(), scratch.begin(), scratch.begin() + count);
+                }
+                if ((g.indices.size() - start) * 10 > before * 9) {
+                    g.indices.resize(start);
+                    break;
+                }
+                // Levels are simplified from each other, so their errors add up.
+                lod.error += previousError;
+                previousError = lod.error;
+                g.object.lods.push_back(std::move(lod));
+            }
+        }
+
+        // Box and sphere around the shape's vertices. The sphere is centred on the
+        // box, with the distance to the furthest vertex as radius.
+        void computeBounds(ObjectGeometry& g) {
+            DrawObject& o = g.object;
+            size_t vertexCount = g.vertices.size() / kVertexFloats;
+            if (vertexCount == 0) return;
+
+            o.bmin = glm::vec3(FLT_MAX);
+            o.bmax = glm::vec3(-FLT_MAX);
+            for (size_t i = 0; i < vertexCount; i++) {
+                glm::vec3 p = positionOf(g, i);
+                o.bmin = glm::min(o.bmin, p);
+                o.bmax = glm::max(o.bmax, p);
+            }
+            o.center = 0.5f * (o.bmin + o.bmax);
+            float radius2 = 0.0f;
+            for (size_t i = 0; i < vertexCount; i++) {
+                glm::vec3 d = positionOf(g, i) - o.center;
+                radius2 = std::max(radius2, glm::dot(d, d));
+            }
+            o.radius = std::sqrt(radius2);
+        }
+
+        // Screen pixels one object-space unit of o covers at its nearest point.
+        float pixelsPerObjectUnit(const DrawObject& o, const glm::mat4& model, const glm::vec3& eye,
+                                  float pixelsPerUnit) {
+            glm::vec3 lo(FLT_MAX);
+            glm::vec3 hi(-FLT_MAX);
+            for (int corner = 0; corner < 8; corner++) {
+                glm::vec3 p((corner & 1) ? o.bmax.x : o.bmin.x,
+                            (corner & 2) ? o.bmax.y : o.bmin.y,
+                            (corner & 4) ? o.bmax.z : o.bmin.z);
+                glm::vec3 w(model * glm::vec4(p, 1.0f));
+                lo = glm::min(lo, w);
+                hi = glm::max(hi, w);
+            }
+            float distance = glm::length(glm::max(glm::max(lo - eye, eye - hi), glm::vec3(0.0f)));
+            float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+                                    glm::length(glm::vec3(model[2]))});
+            return scale * pixelsPerUnit / std::max(distance, Camera::near);
+        }
+
+        // Coarsest level of o whose error projects to under kLodPixelError pixels.
+        const std::vector<SubMesh>& selectLod(const DrawObject& o, float pixelsPerError) {
+            const std::vector<SubMesh>* chosen = &o.subMeshes;
+            for (const MeshLod& lod : o.lods) {
+                if (lod.error * pixelsPerError > kLodPixelError) break;
+                chosen = &lod.subMeshes;
+            }
+            return *chosen;
+        }
+
+        // Asks the streamer for the mip levels of sm's textures that one texel per
+        // screen pixel needs; a sub-mesh without texture coordinates gets the coarsest.
+        void requestTextureLevels(DataTex& data, const SubMesh& sm, float pixelsPerUnit) {
+            const Material& material = data.materials[sm.material_id];
+            for (const TextureLayer& slot : material.layers) {
+                if (slot.array < 0) continue;
+                TextureArray& array = data.textureArrays[slot.array];
+                if (array.sources.empty()) continue;
+                int level = array.levels - 1;
+                if (sm.uvDensity > 0.0f) {
+                    float texelsPerPixel = sm.uvDensity * std::max(array.width, array.height) / pixelsPerUnit;
+                    level = std::clamp(static_cast<int>(std::floor(std::log2(texelsPerPixel))), 0, level);
+                }
+                TextureStreamer::request(array, level);
+            }
+        }
+
+        // Builds the model's object hierarchy from the staged objects' boxes. Objects
+        // are uploaded in order, so primitive i is m_draw_objects[i]. The boxes are
+        // in model space and objects never move within a model, so the tree is built
+        // once per load; moving the model only changes the culling frustum.
+        void buildObjectBvh(StagedModel& model) {
+            std::vector<Aabb> boxes(model.objects.size());
+            for (size_t i = 0; i < boxes.size(); i++) {
+                const StagedObject& s = model.objects[i];
+                if (s.indexCount > 0) {
+                    boxes[i] = {s.object.bmin, s.object.bmax};
+                }
+            }
+            model.data.bvh.build(std::move(boxes));
+        }
+
+        // Cache misses summed over every optimized shape, for the load report.
+        struct CacheTotals {
+            double missesBefore = 0.0;
+            double missesAfter = 0.0;
+            size_t triangles = 0;
+            size_t vertices = 0;
+        };
+
+        // Reorders each sub-mesh for the vertex cache and overdraw, then the whole
+        // shape's vertices for fetch locality. Sub-mesh ranges stay where they are.
+        void optimizeGeometry(ObjectGeometry& g, CacheTotals& totals) {
+            size_t vertexCount = g.vertices.size() / kVertexFloats;
+            // Statistics cover full detail only; coarser levels follow it in the index buffer.
+            size_t fullDetail = 0;
+            for (const SubMesh& sm : g.object.subMeshes) fullDetail += sm.numIndices;
+            VertexCacheStats before = MeshOptimizer::analyzeVertexCache(g.indices.data(), fullDetail, vertexCount);
+
+            // The passes work on compact per-range vertex ids.
+            std::vector<uint32_t> local(vertexCount, UINT32_MAX);
+            std::vector<uint32_t> global;
+            std::vector<float> positions;
+            std::vector<SubMesh> ranges = g.object.subMeshes;
+            for (const MeshLod& lod : g.object.lods) {
+                ranges.insert(ranges.end(), lod.subMeshes.begin(), lod.subMeshes.end());
+            }
+            for (const SubMesh& sm : ranges) {
+                uint32_t* range = g.indices.data() + sm.firstIndex;
+                global.clear();
+                positions.clear();
+                for (size_t i = 0; i < sm.numIndices; i++) {
+                    uint32_t& l = local[range[i]];
+                    if (l == UINT32_MAX) {
+                        l = static_cast<uint32_t>(global.size());
+                        global.push_back(range[i]);
+                        positions.insert(positions.end(), &g.vertices[kVertexFloats * range[i]],
+                                         &g.vertices[kVertexFloats * range[i] + 3]);
+                    }
+                    range[i] = l;
+                }
+
+                MeshOptimizer::optimizeVertexCache(range, sm.numIndices, global.size());
+                MeshOptimizer::optimizeOverdraw(range, sm.numIndices, positions.data(), global.size(), 3);
+
+                for (size_t i = 0; i < sm.numIndices; i++) {
+                    range[i] = global[range[i]];
+                }
+                for (uint32_t v : global) {
+                    local[v] = UINT32_MAX;
+                }
+            }
+            MeshOptimizer::optimizeVertexFetch(g.vertices.data(), vertexCount, kVertexFloats, g.indices.data(),
+                                               g.indices.size());
+
+            VertexCacheStats after = MeshOptimizer::analyzeVertexCache(g.indices.data(), fullDetail, vertexCount);
+            size_t triangles = fullDetail / 3;
+            totals.missesBefore += before.acmr * triangles;
+            totals.missesAfter += after.acmr * triangles;
+            totals.triangles += triangles;
+            totals.vertices += vertexCount;
+        }
+
+        // Turns one OBJ shape into draw-ready geometry: material buckets, unique
+        // vertices, generated normals and tangents, then the optional LOD and
+        // optimization passes. Touches nothing shared, so shapes can build in
+        // parallel.
+        ObjectGeometry buildGeometry(const tinyobj::shape_t& shape, const tinyobj::attrib_t& inattrib,
+                                     const std::vector<Material>& materials, const LoadConfig& loadConfig,
+                                     CacheTotals& totals) {
+            ObjectGeometry geometry{};
+            DrawObject& o = geometry.object;
+            std::vector<float>& buffer = geometry.vertices;  // pos(3), normal(3), tex(2), tangent(2)
+            const size_t materialCount = materials.size();
+            VertexDedup dedup(shape.mesh.indices.size());
+            const auto defaultMaterial = static_cast<int>(materialCount) - 1;
+
+            // Bucket the faces by material (counting sort, keeping face order inside
+            // a bucket) so every material becomes one contiguous index range.
+            size_t numFaces = shape.mesh.indices.size() / 3;
+            std::vector<int> faceMaterial(numFaces);
+            std::vector<size_t> bucketStart(materialCount + 1, 0);
+            for (size_t f = 0; f < numFaces; f++) {
+                int id = f < shape.mesh.material_ids.size() ? shape.mesh.material_ids[f] : -1;
+                if (id < 0 || id >= defaultMaterial) {
+                    id = defaultMaterial;
+                }
+                faceMaterial[f] = id;
+                bucketStart[id + 1]++;
+            }
+            for (size_t m = 0; m < materialCount; m++) {
+                bucketStart[m + 1] += bucketStart[m];
+            }
+            std::vector<size_t> faceOrder(numFaces);
+            std::vector<size_t> cursor(bucketStart.begin(), bucketStart.end() - 1);
+            for (size_t f = 0; f < numFaces; f++) {
+                faceOrder[cursor[faceMaterial[f]]++] = f;
+            }
+            for (size_t m = 0; m < materialCount; m++) {
+                if (bucketStart[m + 1] > bucketStart[m]) {
+                    o.subMeshes.push_back({3 * bucketStart[m], 3 * (bucketStart[m + 1] - bucketStart[m]), m});
+                }
+            }
+
+            // Corners without a normal in the file get a generated one, referred to
+            // as normal index -2 - n so the dedup below keeps smoothing groups apart.
+            std::vector<glm::vec3> generatedNormals;
+            std::vector<uint32_t> cornerNormals;
+            bool missingNormals = false;
+            for (const tinyobj::index_t& idx : shape.mesh.indices) {
+                missingNormals = missingNormals || idx.normal_index < 0 || inattrib.normals.empty();
+            }
+            if (missingNormals && numFaces > 0) {
+                std::vector<uint32_t> corners(shape.mesh.indices.size());
+                for (size_t c = 0; c < corners.size(); c++) {
+                    corners[c] = static_cast<uint32_t>(shape.mesh.indices[c].vertex_index);
+                }
+                // Shapes without any group (no "s" statements, or only "s off") are
+                // smoothed as a whole.
+                const std::vector<unsigned int>& groups = shape.mesh.smoothing_group_ids;
+                bool hasGroups = groups.size() == numFaces
+                                 && std::any_of(groups.begin(), groups.end(), [](unsigned g) { return g != 0; });
+                cornerNormals.resize(corners.size());
+                generatedNormals = MeshTangents::generateNormals(inattrib.vertices.data(), corners.data(),
+                                                                 hasGroups ? groups.data() : nullptr, numFaces,
+                                                                 cornerNormals.data());
+            }
+
+            // Emit one vertex per distinct (vertex, normal, texcoord) triple
+            for (size_t f : faceOrder) {
+                for (size_t k = 0; k < 3; k++) {
+                    tinyobj::index_t idx = shape.mesh.indices[3 * f + k];
+                    if (idx.normal_index < 0 || inattrib.normals.empty()) {
+                        idx.normal_index = -2 - static_cast<int>(cornerNormals[3 * f + k]);
+                    }
+                    auto [slot, inserted] = dedup.insert(idx, static_cast<uint32_t>(buffer.size() / kVertexFloats));
+                    geometry.indices.push_back(slot);
+                    if (!inserted) continue;
+
+                    glm::vec3 v(0.0f);
+                    for (int c = 0; c < 3; c++) {
+                        v[c] = inattrib.vertices[3 * idx.vertex_index + c];
+                    }
+
+                    glm::vec3 n(0.0f);
+                    if (idx.normal_index >= 0) {
+                        for (int c = 0; c < 3; c++) {
+                            n[c] = inattrib.normals[3 * idx.normal_index + c];
+                        }
+                    } else {
+                        n = generatedNormals[-2 - idx.normal_index];
+                    }
+
+                    glm::vec2 tc(0.0f);
+                    if (!inattrib.texcoords.empty() && idx.texcoord_index >= 0) {
+                        tc[0] = inattrib.texcoords[2 * idx.texcoord_index];
+                        tc[1] = 1.0f - inattrib.texcoords[2 * idx.texcoord_index + 1];
+                    }
+
+                    // Store vertex data: position(3), normal(3), texcoords(2); tangents follow below
+                    buffer.insert(buffer.end(), {v[0], v[1], v[2], n[0], n[1], n[2], tc[0], tc[1], 0, 0});
+                }
+            }
+            // Only bump mapping reads tangents; other shapes leave them zero.
+            bool bumped = std::any_of(o.subMeshes.begin(), o.subMeshes.end(), [&](const SubMesh& sm) {
+                return !materials[sm.material_id].texNames.bump_texname.empty();
+            });
+            if (bumped) {
+                MeshTangents::generateTangents(buffer.data(), buffer.size() / kVertexFloats, kVertexFloats,
+                                               geometry.indices.data(), geometry.indices.size());
+            }
+
+            computeBounds(geometry);
+            if (loadConfig.generate_lods && !geometry.indices.empty()) {
+                generateLods(geometry);
+            }
+            if (loadConfig.optimize && !geometry.indices.empty()) {
+                optimizeGeometry(geometry, totals);
+            }
+            return geometry;
+        }
+    }
+
+    CullStats Mesh::cull_stats;
+    DrawStats Mesh::draw_stats;
+
+    bool Mesh::raycast(const DataTex& data, const glm::vec3& origin, const glm::vec3& direction, float& tMax,
+                       RayHit& hit) {
+        return data.bvh.raycast(origin, direction, tMax, [&](uint32_t object, float& closest) {
+            if (object >= data.m_draw_objects.size()) return false;
+            const DrawObject& o = data.m_draw_objects[object];
+            uint32_t triangle;
+            if (!o.bvh || !o.bvh->raycast(origin, direction, closest, triangle)) return false;
+            hit.object = object;
+            hit.triangle = triangle;
+            hit.distance = closest;
+            return true;
+        });
+    }
+
+    GLenum ObjectGeometry::indexType() const {
+        return vertices.size() / kVertexFloats <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    std::vector<unsigned char> ObjectGeometry::packedIndices() const {
+        std::vector<unsigned char> bytes;
+        if (indexType() == GL_UNSIGNED_SHORT) {
+            std::vector<uint16_t> narrow(indices.begin(), indices.end());
+            bytes.resize(narrow.size() * sizeof(uint16_t));
+            std::memcpy(bytes.data(), narrow.data(), bytes.size());
+        } else {
+            bytes.resize(indices.size() * sizeof(uint32_t));
+            std::memcpy(bytes.data(), indices.data(), bytes.size());
+        }
+        return bytes;
+    }
+
+    void Mesh::check_errors(const std::string& desc) {
+        GLenum error;
+        while ((error = glGetError()) != GL_NO_ERROR) {
+            std::cerr << std::format("OpenGL error in \"{}\": {} (0x{:X})\n", desc, error, error);
+        }
+        if (error != GL_NO_ERROR) {
+            std::exit(20);
+        }
+    }
+
+    DataTex Mesh::load_obj(const std::string &filename, const LoadConfig& loadConfig) {
+        StagedModel model = stage_obj(filename, loadConfig);
+        if (!model.valid) {
+            return {};
+        }
+        while (upload_next(model)) {
+        }
+        return std::move(model.data);
+    }
+
+    StagedModel Mesh::stage_obj(const std::string &filename, const LoadConfig& loadConfig) {
+
+        tinyobj::ObjReaderConfig config;
+        config.triangulation_method = "earcut";
+        config.triangulate = true;
+        config.vertex_color = false;
+        config.num_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+        StagedModel model;
+        DataTex& data = model.data;
+        data.format = loadConfig.vertex_format;
+        std::string materialFilename = filename;
+
+        // Load settings that change the cached geometry.
+        uint32_t cacheOptions = (loadConfig.optimize ? 1u : 0u) | (loadConfig.generate_lods ? 2u : 0u);
+        if (MeshCache::load(filename, cacheOptions, model)) {
+            buildObjectBvh(model);
+            Texture::DecodeMaterials(data.materials, materialFilename, model.textures, loadConfig.compress_textures);
+            Texture::PlaceInArrays(model.textures, data);
+            model.valid = true;
+            return model;
+        }
+
+        tinyobj::ObjReader reader;
+        if (!reader.ParseFromFile(filename, config)) {
+            if (!reader.Error().empty()) {
+                std::cerr << "TinyObjReader Error: " << reader.Error() << '\n';
+            }
+            return {};
+        }
+
+        if (!reader.Warning().empty()) {
+            std::cout << "TinyObjReader Warning: " << reader.Warning() << '\n';
+        }
+
+        auto& inattrib = reader.GetAttrib();
+        auto& inshapes = reader.GetShapes();
+        std::vector<tinyobj::material_t> materials = reader.GetMaterials();
+
+        // Append a default material, opaque like the ones tinyobj parses
+        materials.emplace_back().dissolve = 1.0f;
+
+        for (const tinyobj::material_t& mat : materials) {
+            Material m;
+            m.ambient = {mat.ambient[0], mat.ambient[1], mat.ambient[2]};
+            m.diffuse = {mat.diffuse[0], mat.diffuse[1], mat.diffuse[2]};
+            m.specular = {mat.specular[0], mat.specular[1], mat.specular[2]};
+            m.transmittance = {mat.transmittance[0], mat.transmittance[1], mat.transmittance[2]};
+            m.emission = {mat.emission[0], mat.emission[1], mat.emission[2]};
+            m.shininess = mat.shininess;
+            m.ior = mat.ior;
+            m.dissolve = mat.dissolve;
+            m.illum = mat.illum;
+            m.texNames.ambient_texname = mat.ambient_texname;
+            m.texNames.diffuse_texname = mat.diffuse_texname;
+            m.texNames.specular_texname = mat.specular_texname;
+            m.texNames.specular_highlight_texname = mat.specular_highlight_texname;
+            m.texNames.bump_texname = mat.bump_texname;
+            m.texNames.alpha_texname = mat.alpha_texname;
+            m.texNames.reflection_texname = mat.reflection_texname;
+            data.materials.push_back(m);
+        }
+
+        glm::vec3 bmin(FLT_MAX);
+        glm::vec3 bmax(-FLT_MAX);
+
+        // Shapes are independent, so workers take them one at a time.
+        std::vector<ObjectGeometry> objects(inshapes.size());
+        size_t threadCount = std::min<size_t>(std::max(1, config.num_threads), inshapes.size());
+        std::vector<CacheTotals> threadTotals(std::max<size_t>(threadCount, 1));
+        std::atomic<size_t> nextShape{0};
+        auto buildShapes = [&](size_t t) {
+            for (size_t i; (i = nextShape++) < inshapes.size();) {
+                objects[i] = buildGeometry(inshapes[i], inattrib, data.materials, loadConfig, threadTotals[t]);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threadCount; t++) {
+            workers.emplace_back(buildShapes, t);
+        }
+        buildShapes(0);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        CacheTotals cacheTotals;
+        for (const CacheTotals& t : threadTotals) {
+            cacheTotals.missesBefore += t.missesBefore;
+            cacheTotals.missesAfter += t.missesAfter;
+            cacheTotals.triangles += t.triangles;
+            cacheTotals.vertices += t.vertices;
+        }
+        for (const ObjectGeometry& g : objects) {
+            if (!g.vertices.empty()) {
+                bmin = glm::min(bmin, g.object.bmin);
+                bmax = glm::max(bmax, g.object.bmax);
+            }
+        }
+
+        if (cacheTotals.triangles > 0) {
+            auto tris = static_cast<double>(cacheTotals.triangles);
+            auto verts = static_cast<double>(cacheTotals.vertices);
+            std::cout << std::format("Mesh optimizer: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}\n",
+                                     cacheTotals.missesBefore / tris, cacheTotals.missesAfter / tris,
+                                     cacheTotals.missesBefore / verts, cacheTotals.missesAfter / verts);
+        }
+
+        MeshCache::store(filename, cacheOptions, data.materials, objects);
+        data.quantization = VertexLayout::quantization(data.format, bmin, bmax);
+        for (auto& g : objects) {
+            model.objects.push_back(stage(g.object, data, g.vertices.data(), g.vertices.size(),
+                                          g.packedIndices(), g.indices.size(), g.indexType()));
+        }
+        buildObjectBvh(model);
+        Texture::DecodeMaterials(data.materials, materialFilename, model.textures, loadConfig.compress_textures);
+        Texture::PlaceInArrays(model.textures, data);
+        model.valid = true;
+        return model;
+    }
+
+    StagedObject Mesh::stage(const DrawObject& o, const DataTex& data, const float* vertices, size_t floatCount,
+                             std::vector<unsigned char> indices, size_t indexCount, GLenum indexType) {
+        StagedObject s;
+        s.object = o;
+        s.vertexCount = floatCount / kVertexFloats;
+        s.vertices = VertexLayout::pack(data.format, vertices, s.vertexCount, data.quantization);
+        s.indices = std::move(indices);
+        s.indexCount = indexCount;
+        s.indexType = indexType;
+
+        if (indexCount == 0) return s;
+        auto indexAt = [&s, indexType](size_t i) {
+            if (indexType == GL_UNSIGNED_SHORT) {
+                uint16_t narrow;
+                std::memcpy(&narrow, s.indices.data() + i * sizeof(narrow), sizeof(narrow));
+                return static_cast<uint32_t>(narrow);
+            }
+            uint32_t wide;
+            std::memcpy(&wide, s.indices.data() + i * sizeof(wide), sizeof(wide));
+            return wide;
+        };
+
+        // Texture-space extent per object-space unit of each range, from the summed
+        // UV and surface areas, so streaming can tell which mip a draw will sample.
+        auto measureUvDensity = [&](SubMesh& sm) {
+            double surface = 0.0;
+            double uv = 0.0;
+            for (size_t i = sm.firstIndex; i + 2 < sm.firstIndex + sm.numIndices; i += 3) {
+                const float* v[3];
+                for (int k = 0; k < 3; k++) v[k] = vertices + static_cast<size_t>(indexAt(i + k)) * kVertexFloats;
+                glm::vec3 e1 = glm::make_vec3(v[1]) - glm::make_vec3(v[0]);
+                glm::vec3 e2 = glm::make_vec3(v[2]) - glm::make_vec3(v[0]);
+                glm::vec2 t1 = glm::make_vec2(v[1] + 6) - glm::make_vec2(v[0] + 6);
+                glm::vec2 t2 = glm::make_vec2(v[2] + 6) - glm::make_vec2(v[0] + 6);
+                surface += glm::length(glm::cross(e1, e2));
+                uv += std::abs(t1.x * t2.y - t1.y * t2.x);
+            }
+            sm.uvDensity = surface > 0.0 ? static_cast<float>(std::sqrt(uv / surface)) : 0.0f;
+        };
+        for (SubMesh& sm : s.object.subMeshes) measureUvDensity(sm);
+        for (MeshLod& lod : s.object.lods) {
+            for (SubMesh& sm : lod.subMeshes) measureUvDensity(sm);
+        }
+
+        // Triangle hierarchy over the full-detail ranges for ray queries.
+        std::vector<uint32_t> triangles;
+        for (const SubMesh& sm : o.subMeshes) {
+            for (size_t i = sm.firstIndex; i < sm.firstIndex + sm.numIndices; i++) {
+                triangles.push_back(indexAt(i));
+            }
+        }
+        s.object.bvh = std::make_shared<MeshBvh>(vertices, s.vertexCount, kVertexFloats, std::move(triangles));
+        return s;
+    }
+
+    bool Mesh::upload_next(StagedModel& model) {
+        DataTex& data = model.data;
+        if (model.uploaded < model.textures.size()) {
+            TextureImage& image = model.textures[model.uploaded++];
+            Texture::UploadLayer(data.textureArrays[image.placement.array], std::move(image));
+            image = TextureImage();
+            return model.uploaded < model.uploadCount();
+        }
+
+        size_t i = model.uploaded - model.textures.size();
+        if (i >= model.objects.size()) return false;
+        if (i == 0) UniformBuffers::uploadMaterials(data);
+
+        StagedObject& s = model.objects[i];
+        DrawObject& o = s.object;
+        if (s.indexCount > 0) {
+            SceneAllocation a = SceneBuffer::allocate(data.format, s.vertices.data(), s.vertexCount,
+                                                      s.indices.data(), s.indexCount, s.indexType);
+            o.vao = a.vao;
+            o.vbo = a.vbo;
+            o.ebo = a.ebo;
+            o.baseVertex = a.baseVertex;
+            o.indexOffset = a.indexOffset;
+            o.indexType = s.indexType;
+            // The index buffer also holds the coarser levels; count full detail only.
+            o.numTriangles = 0;
+            for (const SubMesh& sm : o.subMeshes) o.numTriangles += sm.numIndices / 3;
+        }
+        data.addObject(o);
+        s = {};
+        model.uploaded++;
+        return model.uploaded < model.uploadCount();
+    }
+
+    namespace {
+        // Vertex decoding and transform uniforms of the last program drawn with.
+        struct VertexUniforms {
+            GLuint program = 0;
+            GLint mvp = -1;
+            GLint posOffset = -1;
+            GLint posScale = -1;
+            GLint octNormals = -1;
+        };
+
+        const VertexUniforms& vertexUniforms(GLuint program) {
+            static VertexUniforms uniforms;
+            if (uniforms.program != program) {
+                uniforms.program = program;
+                uniforms.mvp = Shader::uniform(program, "uMVP");
+                uniforms.posOffset = Shader::uniform(program, "uPosOffset");
+                uniforms.posScale = Shader::uniform(program, "uPosScale");
+                uniforms.octNormals = Shader::uniform(program, "uOctNormals");
+            }
+            return uniforms;
+        }
+
+        // A model waiting in the frame's draw list for Mesh::submit.
+        struct QueuedModel {
+            GLuint program = 0;
+            DataTex* data = nullptr;
+            DrawView view;
+            uint32_t programIndex = 0; // rank of program among the frame's programs, for sort keys
+            bool occlusion = false;    // queries its hidden objects this frame
+            OcclusionPlan plan;
+        };
+        std::vector<QueuedModel> queued;
+
+        // Objects to draw: the frustum query of the model's hierarchy when it has
+        // one, otherwise a sphere test of every object at once followed by the box
+        // test for survivors.
+        void cullObjects(DataTex& data, const DrawView& view, std::vector<uint32_t>& out) {
+            static std::vector<uint8_t> visible;
+            const size_t objectCount = data.m_draw_objects.size();
+            out.clear();
+            if (!view.frustumCulling) {
+                for (uint32_t i = 0; i < objectCount; i++) out.push_back(i);
+                return;
+            }
+            Frustum frustum(view.mvp);
+            if (!data.bvh.empty() && data.bvh.size() == objectCount) {
+                data.bvh.cull(frustum, out);
+            } else if (data.bounds.size() == objectCount) {
+                visible.resize(objectCount);
+                frustum.cullSpheres(data.bounds, visible.data());
+                for (uint32_t i = 0; i < objectCount; i++) {
+                    const DrawObject& o = data.m_draw_objects[i];
+                    if (visible[i] && frustum.intersects(o.bmin, o.bmax)) out.push_back(i);
+                }
+            }
+        }
+
+        // Which sub-mesh ranges of an object recordObjects adds, by pass.
+        enum class RecordFilter { All, Opaque, Transparent };
+
+        // Adds a record per sub-mesh range of the listed objects of queued model m,
+        // at the level of detail and with the texture levels their size on screen needs.
+        void recordObjects(DrawList& list, uint32_t m, const std::vector<uint32_t>& objects, float pixelsPerUnit,
+                           RecordFilter filter = RecordFilter::All) {
+            const QueuedModel& q = queued[m];
+            DataTex& data = *q.data;
+            glm::vec3 eye = Camera::get_position();
+            for (uint32_t i : objects) {
+                const DrawObject& o = data.m_draw_objects[i];
+                float depth = glm::length(glm::vec3(q.view.model * glm::vec4(o.center, 1.0f)) - eye);
+                DrawRecord r;
+                r.model = m;
+                r.vao = o.vao;
+                if (!o.ebo) {
+                    if (filter == RecordFilter::Transparent) continue;
+                    r.key = DrawList::key(DrawPass::Opaque, q.programIndex, m, 0, GL_NONE, depth);
+                    r.count = static_cast<GLsizei>(3 * o.numTriangles);
+                    list.add(r);
+                    continue;
+                }
+                size_t indexSize = o.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+                float objectPixels = pixelsPerObjectUnit(o, q.view.model, eye, pixelsPerUnit);
+                for (const SubMesh& sm : selectLod(o, objectPixels)) {
+                    requestTextureLevels(data, sm, objectPixels);
+                    DrawPass pass = data.materials[sm.material_id].dissolve < 1.0f ? DrawPass::Transparent
+                                                                                     : DrawPass::Opaque;
+                    if ((filter == RecordFilter::Opaque && pass != DrawPass::Opaque)
+                        || (filter == RecordFilter::Transparent && pass != DrawPass::Transparent)) continue;
+                    r.material = static_cast<uint32_t>(sm.material_id);
+                    r.key = DrawList::key(pass, q.programIndex, m, r.material, o.indexType, depth);
+                    r.indexType = o.indexType;
+                    r.count = static_cast<GLsizei>(sm.numIndices);
+                    r.offset = (void*)(o.indexOffset + sm.firstIndex * indexSize);
+                    r.baseVertex = o.baseVertex;
+                    list.add(r);
+                }
+            }
+        }
+
+        // What the last submitted record left bound.
+        struct SubmitState {
+            uint32_t model = UINT32_MAX;
+            uint32_t material = UINT32_MAX;
+        };
+
+        // Issues records [begin, end) of a sorted list in order. A run of records
+        // with the same model, VAO, material and index type becomes a single
+        // glMultiDrawElementsBaseVertex call.
+        void submitRecords(const DrawList& list, size_t begin, size_t end, SubmitState& state) {
+            static std::vector<GLsizei> counts;
+            static std::vector<const void*> offsets;
+            static std::vector<GLint> baseVertices;
+            for (size_t next; begin < end; begin = next) {
+                const DrawRecord& first = list[begin];
+                if (first.model != state.model) {
+                    const QueuedModel& q = queued[first.model];
+                    const VertexUniforms& uniforms = vertexUniforms(q.program);
+                    RenderState::useProgram(q.program);
+                    glUniformMatrix4fv(uniforms.mvp, 1, GL_FALSE, glm::value_ptr(q.view.mvp));
+                    glUniform3fv(uniforms.posOffset, 1, glm::value_ptr(q.data->quantization.offset));
+                    glUniform3fv(uniforms.posScale, 1, glm::value_ptr(q.data->quantization.scale));
+                    glUniform1i(uniforms.octNormals, q.data->format == VertexFormat::Packed16);
+                    // Bound once per model; its draws, conditional ones included, only switch layers.
+                    Texture::BindTextureArrays(*q.data);
+                    state.model = first.model;
+                    state.material = UINT32_MAX;
+                }
+                RenderState::bindVertexArray(first.vao);
+                Mesh::draw_stats.drawCalls++;
+                if (first.indexType == GL_NONE) {
+                    glDrawArrays(GL_TRIANGLES, 0, first.count);
+                    next = begin + 1;
+                    continue;
+                }
+                if (first.material != state.material) {
+                    const DataTex& data = *queued[first.model].data;
+                    Texture::BindMaterialTextures(data.materials[first.material], data);
+                    UniformBuffers::bindMaterial(data, first.material);
+                    state.material = first.material;
+                }
+
+                counts.clear();
+                offsets.clear();
+                baseVertices.clear();
+                for (next = begin; next < end; next++) {
+                    const DrawRecord& r = list[next];
+                    if (r.model != first.model || r.vao != first.vao || r.material != first.material
+                        || r.indexType != first.indexType) break;
+                    counts.push_back(r.count);
+                    offsets.push_back(r.offset);
+                    baseVertices.push_back(r.baseVertex);
+                }
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), first.indexType, offsets.data(),
+                                              static_cast<GLsizei>(counts.size()), baseVertices.data());
+            }
+        }
+    }
+
+    void Mesh::queue(GLuint programID, DataTex& data, const DrawView& view) {
+        QueuedModel& q = queued.emplace_back();
+        q.program = programID;
+        q.data = &data;
+        q.view = view;
+    }
+
+    void Mesh::submit(GLenum face, GLenum type) {
+        RenderState::polygonMode(face, type);
+        RenderState::enable(GL_POLYGON_OFFSET_FILL);
+        RenderState::enable(GL_DEPTH_TEST);
+        RenderState::enable(GL_BLEND);
+        RenderState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        RenderState::polygonOffset(1.0f, 1.0f);
+
+        // Screen pixels covered by one world unit at distance 1, for LOD and mip selection.
+        GLint viewport[4] = {0, 0, 0, 0};
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        const float pixelsPerUnit = viewport[3] / (2.0f * std::tan(glm::radians(Camera::fov) * 0.5f));
+
+        // Lines and points don't hide anything, so occlusion only applies to fills.
+        const bool fill = type == GL_FILL && OcclusionCuller::ready();
+        static DrawList list;
+        static std::vector<GLuint> programs;
+        static std::vector<uint32_t> candidates;
+        list.clear();
+        programs.clear();
+        bool anyOcclusion = false;
+        for (uint32_t m = 0; m < queued.size(); m++) {
+            QueuedModel& q = queued[m];
+            DataTex& data = *q.data;
+            auto program = std::find(programs.begin(), programs.end(), q.program);
+            q.programIndex = static_cast<uint32_t>(program - programs.begin());
+            if (program == programs.end()) programs.push_back(q.program);
+
+            cullObjects(data, q.view, candidates);
+            cull_stats.submitted += candidates.size();
+            cull_stats.culled += data.m_draw_objects.size() - candidates.size();
+            q.occlusion = fill && q.view.occlusionCulling;
+            if (!q.occlusion) {
+                recordObjects(list, m, candidates, pixelsPerUnit);
+                continue;
+            }
+            glm::mat4 toObject = glm::inverse(q.view.model);
+            glm::vec3 eye(toObject * glm::vec4(Camera::get_position(), 1.0f));
+            float nearPlane = Camera::near * glm::length(glm::vec3(toObject[0]));
+            OcclusionCuller::plan(data.occlusion, data.m_draw_objects, candidates, eye, nearPlane, q.plan);
+            recordObjects(list, m, q.plan.visible, pixelsPerUnit);
+            // Blending needs every transparent range in the back-to-front pass,
+            // so those of hidden objects are drawn there without a condition.
+            recordObjects(list, m, q.plan.hidden, pixelsPerUnit, RecordFilter::Transparent);
+            anyOcclusion = true;
+        }
+
+        const auto sortStart = std::chrono::steady_clock::now();
+        list.sort();
+        draw_stats.sortMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sortStart)
+                                     .count();
+        draw_stats.records += list.size();
+
+        size_t transparent = 0;
+        while (transparent < list.size() && DrawList::pass(list[transparent].key) == DrawPass::Opaque) transparent++;
+        SubmitState state;
+        submitRecords(list, 0, transparent, state);
+
+        if (anyOcclusion) {
+            // Every model's occluders are in the depth buffer now, so the proxies
+            // of one model are also tested against the others.
+            for (QueuedModel& q : queued) {
+                if (q.occlusion) OcclusionCuller::query(q.data->occlusion, q.data->m_draw_objects, q.plan, q.view.mvp);
+            }
+            OcclusionCuller::restore();
+            RenderState::polygonMode(face, type);
+            state = {};
+
+            // Let the GPU skip whatever this frame's queries found hidden.
+            static DrawList single;
+            static std::vector<uint32_t> object(1);
+            for (uint32_t m = 0; m < queued.size(); m++) {
+                QueuedModel& q = queued[m];
+                if (!q.occlusion) continue;
+                for (uint32_t i : q.plan.hidden) {
+                    object[0] = i;
+                    single.clear();
+                    recordObjects(single, m, object, pixelsPerUnit, RecordFilter::Opaque);
+                    if (single.size() == 0) continue;
+                    single.sort();
+                    OcclusionCuller::beginConditional(q.data->occlusion, i);
+                    submitRecords(single, 0, single.size(), state);
+                    OcclusionCuller::endConditional();
+                }
+                cull_stats.queried += q.plan.queried.size();
+                cull_stats.occluded += q.plan.hidden.size();
+            }
+        }
+
+        // Blended over everything opaque, back to front.
+        submitRecords(list, transparent, list.size(), state);
+        RenderState::bindVertexArray(0);
+        queued.clear();
+    }
+
+    void Mesh::draw(GLenum face, GLenum type, GLuint programID, DataTex& data, const DrawView& view) {
+        queue(programID, data, view);
+        submit(face, type);
+    }
+}
@@ -1,18 +1,115 @@
-#pragma once
-
-#include <vector>
-#include "debug.h"
-#include "texture.h"
-
-namespace gl {
-
-class Mesh{
-
-public:
-
-    static DataTex load_obj(const std::string &filename);
-    static void draw(GLenum face, GLenum type, GLuint programID, gl::DataTex& data);
-    static void check_errors(const std::string& desc);
-
-};
-}
\ No newline at end of file
+#pragma once
+
+#include <vector>
+#include "debug.h"
+#include "texture.h"
+
+namespace gl {
+
+// CPU-side result of loading one shape, kept until it is uploaded and cached.
+struct ObjectGeometry {
+    DrawObject object;
+    std::vector<float> vertices; // pos(3), normal(3), tex(2), tangent(2)
+    std::vector<uint32_t> indices;
+
+    // 16-bit indices whenever the shape's vertices fit, 32-bit otherwise.
+    [[nodiscard]] GLenum indexType() const;
+    [[nodiscard]] std::vector<unsigned char> packedIndices() const;
+};
+
+// GPU-ready copy of one DrawObject: vertices already in the model's vertex
+// format, indices packed to the object's index type.
+struct StagedObject {
+    DrawObject object;
+    std::vector<unsigned char> vertices;
+    size_t vertexCount = 0;
+    std::vector<unsigned char> indices;
+    size_t indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+};
+
+// A model loaded on the CPU by Mesh::stage_obj and waiting for its GL uploads
+// (Mesh::upload_next). Owns no GL objects until then.
+struct StagedModel {
+    bool valid = false;
+    DataTex data; // materials and vertex format; textures and objects are added on upload
+    std::vector<TextureImage> textures;
+    std::vector<StagedObject> objects;
+    size_t uploaded = 0; // textures first, then objects
+
+    [[nodiscard]] size_t uploadCount() const { return textures.size() + objects.size(); }
+};
+
+// Options for Mesh::load_obj.
+struct LoadConfig {
+    VertexFormat vertex_format = VertexFormat::Float32;
+    bool optimize = false; // reorder for vertex cache, overdraw and vertex fetch
+    bool generate_lods = false; // build simplified levels of detail per shape
+    bool compress_textures = false; // BC1/BC3/BC4/BC5 textures through the texture cache
+};
+
+// Objects submitted and skipped by frustum culling in Mesh::draw, and occlusion
+// query outcomes, summed until reset.
+struct CullStats {
+    size_t submitted = 0;
+    size_t culled = 0;
+    size_t queried = 0;  // objects tested with an occlusion query
+    size_t occluded = 0; // of those, hidden according to the previous frame
+};
+
+// Records in the frame's draw lists, the draw calls they were merged into and
+// the time spent sorting them, summed until reset.
+struct DrawStats {
+    size_t records = 0;
+    size_t drawCalls = 0;
+    double sortMs = 0.0;
+};
+
+// Where Mesh::draw is seen from and which culling it applies.
+struct DrawView {
+    glm::mat4 model{1.0f}; // places the data in the world, for LOD selection
+    glm::mat4 mvp{1.0f};   // projection * view * model, for culling
+    bool frustumCulling = false;
+    bool occlusionCulling = false;
+};
+
+// Closest triangle found by Mesh::raycast.
+struct RayHit {
+    size_t object = 0;     // index into DataTex::m_draw_objects
+    uint32_t triangle = 0; // full-detail triangle of that object
+    float distance = 0.0f; // in units of the ray direction's length
+};
+
+class Mesh{
+
+public:
+
+    static DataTex load_obj(const std::string &filename, const LoadConfig& loadConfig = {});
+    // The CPU half of load_obj: parsing (or the mesh cache), processing and
+    // texture decoding. Makes no GL calls, so it may run on any thread.
+    static StagedModel stage_obj(const std::string &filename, const LoadConfig& loadConfig = {});
+    // Converts Float32 vertices to data.format and takes the packed indices.
+    static StagedObject stage(const DrawObject& o, const DataTex& data, const float* vertices, size_t floatCount,
+                              std::vector<unsigned char> indices, size_t indexCount, GLenum indexType);
+    // Performs the next pending GL upload of a staged model on the GL thread.
+    // Returns true while more uploads remain.
+    static bool upload_next(StagedModel& model);
+    // Adds data to the frame's draw list; data must stay alive until submit.
+    static void queue(GLuint programID, gl::DataTex& data, const DrawView& view = {});
+    // Culls the queued models and draws them as one list sorted by pass, program,
+    // model, material and depth (front to back, back to front for transparent
+    // materials), then empties the list.
+    static void submit(GLenum face, GLenum type);
+    // Queues data alone and submits it.
+    static void draw(GLenum face, GLenum type, GLuint programID, gl::DataTex& data, const DrawView& view = {});
+    static void check_errors(const std::string& desc);
+    // Closest hit of origin + t * direction, t in [0, tMax], with the model's
+    // triangles, in the data's object space. Lowers tMax on a hit.
+    static bool raycast(const DataTex& data, const glm::vec3& origin, const glm::vec3& direction, float& tMax,
+                        RayHit& hit);
+
+    static CullStats cull_stats;
+    static DrawStats draw_stats;
+
+};
+}
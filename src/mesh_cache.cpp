@@ -0,0 +1,455 @@
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+#include "mapped_file.h"
+#include "mesh.h"
+
+namespace gl {
+
+    namespace {
+        constexpr char kMagic[8] = {'G', 'L', 'M', 'E', 'S', 'H', '\0', '\0'};
+
+        struct CacheHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t objectCount;
+            uint64_t sourceSize;
+            int64_t sourceMtime;
+            uint32_t materialCount;
+            uint32_t options;
+            uint32_t pathLength;   // followed by the source path
+            uint32_t libraryCount; // then this many LibraryRecords, after their paths
+        };
+
+        // Size and modification time of a material library the source names,
+        // after the library's path (length-prefixed). Libraries missing when the
+        // cache was written have size kMissing.
+        struct LibraryRecord {
+            uint64_t size;
+            int64_t mtime;
+        };
+        constexpr uint64_t kMissing = UINT64_MAX;
+
+        // Fixed-size part of a Material record, followed by its texture names.
+        struct MaterialRecord {
+            float ambient[3];
+            float diffuse[3];
+            float specular[3];
+            float transmittance[3];
+            float emission[3];
+            float shininess;
+            float ior;
+            float dissolve;
+            int32_t illum;
+        };
+
+        struct SubMeshRecord {
+            uint64_t firstIndex;
+            uint64_t numIndices;
+            uint64_t materialId;
+        };
+
+        // Header of one level of detail, followed by subMeshCount SubMeshRecords.
+        struct LodRecord {
+            float error;
+            uint32_t subMeshCount;
+        };
+
+        // Fixed-size part of a DrawObject record. subMeshCount SubMeshRecords,
+        // lodCount LodRecords, the vertex stream (floatCount floats) and the index
+        // stream (indexCount indices of indexSize bytes) follow it, each stream
+        // 4-byte aligned.
+        struct ObjectRecord {
+            float bmin[3];
+            float bmax[3];
+            float center[3];
+            float radius;
+            uint64_t floatCount;
+            uint64_t indexCount;
+            uint32_t indexSize;
+            uint32_t subMeshCount;
+            uint32_t lodCount;
+            uint32_t pad;
+        };
+
+        static_assert(std::is_trivially_copyable_v<CacheHeader>);
+        static_assert(std::is_trivially_copyable_v<LibraryRecord>);
+        static_assert(std::is_trivially_copyable_v<MaterialRecord>);
+        static_assert(std::is_trivially_copyable_v<SubMeshRecord>);
+        static_assert(std::is_trivially_copyable_v<LodRecord>);
+        static_assert(std::is_trivially_copyable_v<ObjectRecord>);
+
+        std::string texture_names::* const kTextureFields[] = {
+                &texture_names::ambient_texname,
+                &texture_names::diffuse_texname,
+                &texture_names::specular_texname,
+                &texture_names::specular_highlight_texname,
+                &texture_names::bump_texname,
+                &texture_names::alpha_texname,
+                &texture_names::reflection_texname,
+        };
+
+        struct SourceKey {
+            std::string path;
+            uint64_t size = 0;
+            int64_t mtime = 0;
+        };
+
+        bool sourceKey(const std::string& filename, SourceKey& key) {
+            std::error_code ec;
+            auto path = std::filesystem::absolute(filename, ec);
+            if (ec) return false;
+            key.path = path.lexically_normal().string();
+            key.size = std::filesystem::file_size(path, ec);
+            if (ec) return false;
+            key.mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+            return !ec;
+        }
+
+        // Key of a material library, with size kMissing when it cannot be read.
+        SourceKey libraryKey(const std::string& filename) {
+            SourceKey key;
+            if (!sourceKey(filename, key)) {
+                key.path = filename;
+                key.size = kMissing;
+                key.mtime = 0;
+            }
+            return key;
+        }
+
+        // Material libraries named by the OBJ's mtllib lines, resolved next to
+        // the OBJ as tinyobj resolves them.
+        std::vector<std::string> materialLibraries(const std::string& filename) {
+            std::vector<std::string> libraries;
+            MappedFile file(filename);
+            if (!file.valid()) return libraries;
+            std::string_view text(reinterpret_cast<const char*>(file.data()), file.size());
+            const std::filesystem::path dir = std::filesystem::path(filename).parent_path();
+            constexpr std::string_view kDirective = "mtllib";
+            constexpr const char* kSpace = " \t\r";
+            for (size_t pos = 0; pos < text.size();) {
+                size_t end = std::min(text.find('\n', pos), text.size());
+                std::string_view line = text.substr(pos, end - pos);
+                pos = end + 1;
+                size_t first = line.find_first_not_of(kSpace);
+                if (first == std::string_view::npos || line.substr(first, kDirective.size()) != kDirective) continue;
+                line.remove_prefix(first + kDirective.size());
+                if (line.empty() || line.find_first_of(kSpace) != 0) continue;
+                while ((first = line.find_first_not_of(kSpace)) != std::string_view::npos) {
+                    line.remove_prefix(first);
+                    size_t length = std::min(line.find_first_of(kSpace), line.size());
+                    libraries.push_back((dir / std::string(line.substr(0, length))).string());
+                    line.remove_prefix(length);
+                }
+            }
+            return libraries;
+        }
+
+        // Bounds-checked cursor over the mapped cache file.
+        struct Reader {
+            const unsigned char* pos;
+            const unsigned char* end;
+
+            [[nodiscard]] size_t remaining() const { return static_cast<size_t>(end - pos); }
+            const unsigned char* take(size_t n) {
+                if (static_cast<size_t>(end - pos) < n) return nullptr;
+                const unsigned char* p = pos;
+                pos += n;
+                return p;
+            }
+            bool read(void* dst, size_t n) {
+                const unsigned char* p = take(n);
+                if (p) std::memcpy(dst, p, n);
+                return p != nullptr;
+            }
+            bool align(size_t a) {
+                size_t offset = reinterpret_cast<uintptr_t>(pos) % a;
+                return offset == 0 || take(a - offset);
+            }
+        };
+
+        struct Writer {
+            std::vector<char> bytes;
+
+            void write(const void* src, size_t n) {
+                auto p = static_cast<const char*>(src);
+                bytes.insert(bytes.end(), p, p + n);
+            }
+            void writeString(const std::string& s) {
+                auto length = static_cast<uint32_t>(s.size());
+                write(&length, sizeof(length));
+                write(s.data(), s.size());
+            }
+            void align(size_t a) {
+                bytes.resize((bytes.size() + a - 1) / a * a, '\0');
+            }
+        };
+
+        void toArray(const glm::vec3& v, float (&out)[3]) {
+            out[0] = v.x; out[1] = v.y; out[2] = v.z;
+        }
+
+        // Whether all count indices of a stream name one of its vertexCount vertices.
+        template <typename Index>
+        bool indicesInRange(const unsigned char* bytes, size_t count, size_t vertexCount) {
+            for (size_t i = 0; i < count; i++) {
+                Index index;
+                std::memcpy(&index, bytes + i * sizeof(Index), sizeof(Index));
+                if (index >= vertexCount) return false;
+            }
+            return true;
+        }
+
+        glm::vec3 fromArray(const float (&in)[3]) {
+            return {in[0], in[1], in[2]};
+        }
+    }
+
+    std::string MeshCache::cachePath(const std::string& filename) {
+        return filename + ".meshcache";
+    }
+
+    bool MeshCache::load(const std::string& filename, uint32_t options, StagedModel& model) {
+        SourceKey key;
+        if (!sourceKey(filename, key)) return false;
+
+        MappedFile file(cachePath(filename));
+        if (!file.valid()) return false;
+
+        Reader in{file.data(), file.data() + file.size()};
+        CacheHeader header{};
+        if (!in.read(&header, sizeof(header))
+            || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+            || header.version != loader_version
+            || header.options != options
+            || header.sourceSize != key.size
+            || header.sourceMtime != key.mtime) {
+            return false;
+        }
+        const unsigned char* path = in.take(header.pathLength);
+        if (!path || key.path != std::string_view(reinterpret_cast<const char*>(path), header.pathLength)) {
+            return false;
+        }
+
+        // Materials come from the libraries, so editing one invalidates the cache.
+        for (uint32_t i = 0; i < header.libraryCount; i++) {
+            uint32_t length = 0;
+            LibraryRecord r{};
+            const unsigned char* library = in.read(&length, sizeof(length)) ? in.take(length) : nullptr;
+            if (!library || !in.read(&r, sizeof(r))) return false;
+            SourceKey current = libraryKey(std::string(reinterpret_cast<const char*>(library), length));
+            if (current.size != r.size || current.mtime != r.mtime) return false;
+        }
+
+        // Counts come from disk: bound them by the bytes left before allocating,
+        // so a corrupt file is a miss rather than a huge allocation.
+        constexpr size_t kMinMaterialBytes = sizeof(MaterialRecord) + std::size(kTextureFields) * sizeof(uint32_t);
+        if (header.materialCount > in.remaining() / kMinMaterialBytes) return false;
+        std::vector<Material> materials(header.materialCount);
+        for (Material& m : materials) {
+            MaterialRecord r{};
+            if (!in.read(&r, sizeof(r))) return false;
+            m.ambient = fromArray(r.ambient);
+            m.diffuse = fromArray(r.diffuse);
+            m.specular = fromArray(r.specular);
+            m.transmittance = fromArray(r.transmittance);
+            m.emission = fromArray(r.emission);
+            m.shininess = r.shininess;
+            m.ior = r.ior;
+            m.dissolve = r.dissolve;
+            m.illum = r.illum;
+
+            for (auto field : kTextureFields) {
+                uint32_t length = 0;
+                if (!in.read(&length, sizeof(length))) return false;
+                const unsigned char* s = in.take(length);
+                if (!s) return false;
+                (m.texNames.*field).assign(reinterpret_cast<const char*>(s), length);
+            }
+        }
+
+        if (header.objectCount > in.remaining() / sizeof(ObjectRecord)) return false;
+        std::vector<DrawObject> objects(header.objectCount);
+        struct Streams {
+            const float* vertices;
+            size_t floatCount;
+            const unsigned char* indices;
+            size_t indexCount;
+            GLenum indexType;
+        };
+        std::vector<Streams> streams(header.objectCount);
+        for (uint32_t i = 0; i < header.objectCount; i++) {
+            ObjectRecord r{};
+            if (!in.read(&r, sizeof(r))) return false;
+
+            DrawObject& o = objects[i];
+            o.bmin = fromArray(r.bmin);
+            o.bmax = fromArray(r.bmax);
+            o.center = fromArray(r.center);
+            o.radius = r.radius;
+
+            auto readSubMeshes = [&](uint32_t count, std::vector<SubMesh>& out) {
+                for (uint32_t k = 0; k < count; k++) {
+                    SubMeshRecord sm{};
+                    if (!in.read(&sm, sizeof(sm))) return false;
+                    if (sm.materialId >= materials.size() || sm.firstIndex + sm.numIndices > r.indexCount) return false;
+                    out.push_back({sm.firstIndex, sm.numIndices, sm.materialId});
+                }
+                return true;
+            };
+            if (!readSubMeshes(r.subMeshCount, o.subMeshes)) return false;
+            if (r.lodCount > in.remaining() / sizeof(LodRecord)) return false;
+            o.lods.resize(r.lodCount);
+            for (MeshLod& lod : o.lods) {
+                LodRecord lr{};
+                if (!in.read(&lr, sizeof(lr)) || !readSubMeshes(lr.subMeshCount, lod.subMeshes)) return false;
+                lod.error = lr.error;
+            }
+
+            if (r.indexSize != sizeof(uint16_t) && r.indexSize != sizeof(uint32_t)) return false;
+            if (!in.align(alignof(float))) return false;
+            const unsigned char* vertices = in.take(r.floatCount * sizeof(float));
+            if (!vertices || !in.align(alignof(uint32_t))) return false;
+            const unsigned char* indices = in.take(r.indexCount * r.indexSize);
+            if (!indices) return false;
+            // Staging packs whole vertices and builds the BVH from the indices.
+            constexpr size_t kVertexFloats = VertexLayout::floats_per_vertex;
+            if (r.floatCount % kVertexFloats != 0) return false;
+            const size_t vertexCount = r.floatCount / kVertexFloats;
+            if (r.indexSize == sizeof(uint16_t) ? !indicesInRange<uint16_t>(indices, r.indexCount, vertexCount)
+                                                : !indicesInRange<uint32_t>(indices, r.indexCount, vertexCount)) {
+                return false;
+            }
+            streams[i] = {reinterpret_cast<const float*>(vertices), r.floatCount, indices, r.indexCount,
+                          static_cast<GLenum>(r.indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT)};
+        }
+
+        glm::vec3 bmin(FLT_MAX);
+        glm::vec3 bmax(-FLT_MAX);
+        for (uint32_t i = 0; i < header.objectCount; i++) {
+            if (streams[i].indexCount > 0) {
+                bmin = glm::min(bmin, objects[i].bmin);
+                bmax = glm::max(bmax, objects[i].bmax);
+            }
+        }
+        DataTex& data = model.data;
+        data.quantization = VertexLayout::quantization(data.format, bmin, bmax);
+
+        // Only stage once the whole file validated, so a truncated cache yields nothing.
+        for (uint32_t i = 0; i < header.objectCount; i++) {
+            const Streams& st = streams[i];
+            size_t indexSize = st.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+            std::vector<unsigned char> indices(st.indices, st.indices + st.indexCount * indexSize);
+            model.objects.push_back(Mesh::stage(objects[i], data, st.vertices, st.floatCount,
+                                                std::move(indices), st.indexCount, st.indexType));
+        }
+        data.materials = std::move(materials);
+        return true;
+    }
+
+    void MeshCache::store(const std::string& filename, uint32_t options, const std::vector<Material>& materials,
+                          const std::vector<ObjectGeometry>& objects) {
+        SourceKey key;
+        if (!sourceKey(filename, key)) return;
+
+        Writer out;
+        CacheHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = loader_version;
+        header.objectCount = static_cast<uint32_t>(objects.size());
+        header.materialCount = static_cast<uint32_t>(materials.size());
+        header.options = options;
+        header.sourceSize = key.size;
+        header.sourceMtime = key.mtime;
+        header.pathLength = static_cast<uint32_t>(key.path.size());
+        std::vector<std::string> libraries = materialLibraries(filename);
+        header.libraryCount = static_cast<uint32_t>(libraries.size());
+        out.write(&header, sizeof(header));
+        out.write(key.path.data(), key.path.size());
+        for (const std::string& library : libraries) {
+            SourceKey stamp = libraryKey(library);
+            out.writeString(stamp.path);
+            LibraryRecord r{stamp.size, stamp.mtime};
+            out.write(&r, sizeof(r));
+        }
+
+        for (const Material& m : materials) {
+            MaterialRecord r{};
+            toArray(m.ambient, r.ambient);
+            toArray(m.diffuse, r.diffuse);
+            toArray(m.specular, r.specular);
+            toArray(m.transmittance, r.transmittance);
+            toArray(m.emission, r.emission);
+            r.shininess = m.shininess;
+            r.ior = m.ior;
+            r.dissolve = m.dissolve;
+            r.illum = m.illum;
+            out.write(&r, sizeof(r));
+
+            for (auto field : kTextureFields) {
+                out.writeString(m.texNames.*field);
+            }
+        }
+
+        for (const auto& g : objects) {
+            const DrawObject& o = g.object;
+            ObjectRecord r{};
+            toArray(o.bmin, r.bmin);
+            toArray(o.bmax, r.bmax);
+            toArray(o.center, r.center);
+            r.radius = o.radius;
+            r.floatCount = g.vertices.size();
+            r.indexCount = g.indices.size();
+            r.indexSize = g.indexType() == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+            r.subMeshCount = static_cast<uint32_t>(o.subMeshes.size());
+            r.lodCount = static_cast<uint32_t>(o.lods.size());
+            out.write(&r, sizeof(r));
+
+            auto writeSubMeshes = [&](const std::vector<SubMesh>& subMeshes) {
+                for (const SubMesh& sm : subMeshes) {
+                    SubMeshRecord record{sm.firstIndex, sm.numIndices, sm.material_id};
+                    out.write(&record, sizeof(record));
+                }
+            };
+            writeSubMeshes(o.subMeshes);
+            for (const MeshLod& lod : o.lods) {
+                LodRecord lr{lod.error, static_cast<uint32_t>(lod.subMeshes.size())};
+                out.write(&lr, sizeof(lr));
+                writeSubMeshes(lod.subMeshes);
+            }
+            out.align(alignof(float));
+            out.write(g.vertices.data(), g.vertices.size() * sizeof(float));
+            std::vector<unsigned char> indices = g.packedIndices();
+            out.align(alignof(uint32_t));
+            out.write(indices.data(), indices.size());
+        }
+
+        // Write to a temporary and rename, so a concurrent reader never sees a partial file.
+        std::string path = cachePath(filename);
+        // Per-thread temporary, in case two loads of the same model run concurrently.
+        std::string tmp = path + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        {
+            std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+            if (!file.write(out.bytes.data(), static_cast<std::streamsize>(out.bytes.size()))) {
+                std::cerr << "Could not write mesh cache: " << tmp << "\n";
+                return;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) {
+            std::cerr << "Could not write mesh cache: " << path << " (" << ec.message() << ")\n";
+            std::filesystem::remove(tmp, ec);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "texture.h"
+
+namespace gl {
+
+struct ObjectGeometry;
+struct StagedModel;
+
+// Binary cache of the materials and GPU-ready vertex/index streams built by
+// Mesh::load_obj.
+// Written next to the source as "<file>.meshcache" and keyed by the source
+// path, size, modification time and loader version, and by the size and
+// modification time of every material library it names. A hit is memory-mapped and
+// read without any OBJ parsing; its streams are checked to stay in bounds, then
+// staged like freshly built geometry (packed, with per-object BVHs rebuilt).
+class MeshCache {
+public:
+    // Bump whenever the layout or contents produced by load_obj change.
+    static constexpr uint32_t loader_version = 10;
+
+    // options encodes the load settings that change the geometry; a cache
+    // written with different options is a miss. Stages the objects in
+    // model.data.format without touching GL.
+    static bool load(const std::string& filename, uint32_t options, StagedModel& model);
+    static void store(const std::string& filename, uint32_t options, const std::vector<Material>& materials,
+                      const std::vector<ObjectGeometry>& objects);
+
+private:
+    static std::string cachePath(const std::string& filename);
+};
+}
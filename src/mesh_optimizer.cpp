@@ -0,0 +1,259 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace gl {
+
+    namespace {
+        // FIFO post-transform cache, emulated with insertion timestamps: a vertex
+        // is cached while fewer than `size` vertices were inserted after it.
+        class FifoCache {
+        public:
+            FifoCache(size_t vertexCount, unsigned size)
+                : m_stamps(vertexCount, 0), m_time(size + 1), m_size(size) {}
+
+            // Returns true on a miss and inserts v.
+            bool access(uint32_t v) {
+                if (m_time - m_stamps[v] <= m_size) return false;
+                m_stamps[v] = m_time++;
+                return true;
+            }
+
+            void flush() {
+                m_time += m_size + 1;
+            }
+
+        private:
+            std::vector<uint32_t> m_stamps;
+            uint32_t m_time;
+            unsigned m_size;
+        };
+
+        unsigned triangleMisses(FifoCache& cache, const uint32_t* tri) {
+            return cache.access(tri[0]) + cache.access(tri[1]) + cache.access(tri[2]);
+        }
+    }
+
+    VertexCacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount,
+                                                       size_t vertexCount, unsigned cacheSize) {
+        VertexCacheStats stats;
+        if (indexCount < 3) return stats;
+
+        FifoCache cache(vertexCount, cacheSize);
+        std::vector<bool> referenced(vertexCount, false);
+        size_t misses = 0;
+        size_t unique = 0;
+        for (size_t i = 0; i < indexCount; i++) {
+            misses += cache.access(indices[i]);
+            if (!referenced[indices[i]]) {
+                referenced[indices[i]] = true;
+                unique++;
+            }
+        }
+        stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+        stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+        return stats;
+    }
+
+    void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+        const size_t triCount = indexCount / 3;
+        if (triCount == 0) return;
+
+        // Vertex -> triangle adjacency, and the number of not yet emitted
+        // triangles using each vertex.
+        std::vector<uint32_t> live(vertexCount, 0);
+        for (size_t i = 0; i < indexCount; i++) {
+            live[indices[i]]++;
+        }
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] = offsets[v] + live[v];
+        }
+        std::vector<uint32_t> adjacency(indexCount);
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indexCount; i++) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triCount, false);
+        std::vector<uint32_t> deadEnd;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> result;
+        result.reserve(indexCount);
+
+        uint32_t time = kCacheSize + 1;
+        size_t cursor = 0;
+        int64_t fan = 0;
+        while (fan >= 0) {
+            // Emit every remaining triangle around the fanning vertex.
+            candidates.clear();
+            for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++) {
+                uint32_t t = adjacency[a];
+                if (emitted[t]) continue;
+                emitted[t] = true;
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t v = indices[3 * t + k];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cacheTime[v] > kCacheSize) {
+                        cacheTime[v] = time++;
+                    }
+                }
+            }
+
+            // Next fan: the oldest candidate that will still be cached after its
+            // remaining triangles are emitted.
+            int64_t best = -1;
+            int64_t bestPriority = -1;
+            for (uint32_t v : candidates) {
+                if (live[v] == 0) continue;
+                int64_t priority = 0;
+                if (time - cacheTime[v] + 2 * live[v] <= kCacheSize) {
+                    priority = time - cacheTime[v];
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    best = v;
+                }
+            }
+
+            // Dead end: fall back to recently used vertices, then to any vertex.
+            while (best < 0 && !deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) best = v;
+            }
+            while (best < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0) best = static_cast<int64_t>(cursor);
+                cursor++;
+            }
+            fan = best;
+        }
+
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* vertices,
+                                         size_t vertexCount, size_t stride, float threshold) {
+        const size_t triCount = indexCount / 3;
+        if (triCount < 2) return;
+
+        // Hard boundaries: triangles where the cache-optimized order jumped, i.e.
+        // all three vertices miss.
+        std::vector<size_t> hard;
+        {
+            FifoCache cache(vertexCount, kCacheSize);
+            for (size_t t = 0; t < triCount; t++) {
+                if (triangleMisses(cache, indices + 3 * t) == 3) hard.push_back(t);
+            }
+            hard.push_back(triCount);
+        }
+
+        // Soft boundaries: split a hard cluster as soon as the part so far is
+        // within threshold of the cluster's own ACMR, so reordering the pieces
+        // costs little cache efficiency.
+        std::vector<size_t> clusters;
+        FifoCache cache(vertexCount, kCacheSize);
+        for (size_t h = 0; h + 1 < hard.size(); h++) {
+            size_t begin = hard[h];
+            size_t end = hard[h + 1];
+
+            cache.flush();
+            size_t clusterMisses = 0;
+            for (size_t t = begin; t < end; t++) {
+                clusterMisses += triangleMisses(cache, indices + 3 * t);
+            }
+            float limit = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+            cache.flush();
+            clusters.push_back(begin);
+            size_t start = begin;
+            size_t misses = 0;
+            for (size_t t = begin; t < end; t++) {
+                misses += triangleMisses(cache, indices + 3 * t);
+                if (t + 1 < end && static_cast<float>(misses) / static_cast<float>(t - start + 1) <= limit) {
+                    clusters.push_back(t + 1);
+                    start = t + 1;
+                    misses = 0;
+                    cache.flush();
+                }
+            }
+        }
+        clusters.push_back(triCount);
+
+        auto position = [&](uint32_t v) {
+            const float* p = vertices + v * stride;
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+
+        glm::vec3 meshCentroid(0.0f);
+        for (size_t v = 0; v < vertexCount; v++) {
+            meshCentroid += position(static_cast<uint32_t>(v));
+        }
+        meshCentroid /= static_cast<float>(vertexCount);
+
+        // Clusters that face away from the mesh centre are likely to occlude the
+        // rest, so they draw first.
+        struct Cluster {
+            size_t begin;
+            size_t end;
+            float sortKey;
+        };
+        std::vector<Cluster> order;
+        for (size_t c = 0; c + 1 < clusters.size(); c++) {
+            glm::vec3 centroid(0.0f);
+            glm::vec3 normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+                glm::vec3 p0 = position(indices[3 * t]);
+                glm::vec3 p1 = position(indices[3 * t + 1]);
+                glm::vec3 p2 = position(indices[3 * t + 2]);
+                glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                float a = glm::length(n);
+                centroid += (p0 + p1 + p2) * (a / 3.0f);
+                normal += n;
+                area += a;
+            }
+            float key = 0.0f;
+            if (area > 0.0f && glm::length(normal) > 0.0f) {
+                key = glm::dot(centroid / area - meshCentroid, glm::normalize(normal));
+            }
+            order.push_back({clusters[c], clusters[c + 1], key});
+        }
+        std::stable_sort(order.begin(), order.end(), [](const Cluster& a, const Cluster& b) {
+            return a.sortKey > b.sortKey;
+        });
+
+        std::vector<uint32_t> result;
+        result.reserve(triCount * 3);
+        for (const Cluster& c : order) {
+            result.insert(result.end(), indices + 3 * c.begin, indices + 3 * c.end);
+        }
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    void MeshOptimizer::optimizeVertexFetch(float* vertices, size_t vertexCount, size_t stride,
+                                            uint32_t* indices, size_t indexCount) {
+        std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+        uint32_t next = 0;
+        for (size_t i = 0; i < indexCount; i++) {
+            uint32_t& r = remap[indices[i]];
+            if (r == UINT32_MAX) r = next++;
+            indices[i] = r;
+        }
+        // Unreferenced vertices keep their relative order at the end.
+        for (uint32_t& r : remap) {
+            if (r == UINT32_MAX) r = next++;
+        }
+
+        std::vector<float> reordered(vertexCount * stride);
+        for (size_t v = 0; v < vertexCount; v++) {
+            std::copy(vertices + v * stride, vertices + (v + 1) * stride, reordered.begin() + remap[v] * stride);
+        }
+        std::copy(reordered.begin(), reordered.end(), vertices);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gl {
+
+// Post-transform vertex cache efficiency of an index buffer, measured with a
+// FIFO cache simulation.
+struct VertexCacheStats {
+    float acmr = 0.0f; // average cache misses per triangle, 0.5 is optimal for grids, 3 is worst
+    float atvr = 0.0f; // cache misses per referenced vertex, 1 is optimal
+};
+
+// Triangle and vertex reordering passes for indexed triangle lists. Indices
+// are 32-bit and vertices are interleaved with a stride given in floats, with
+// the position in the first three floats.
+class MeshOptimizer {
+public:
+    static constexpr unsigned kCacheSize = 16;
+
+    // Tipsify (Sander et al. 2007): reorders triangles for post-transform cache
+    // locality in linear time.
+    static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+    // View-independent overdraw reduction: splits a cache-optimized order into
+    // clusters at cache flushes and sorts them so outward-facing clusters draw
+    // first. threshold bounds how much ACMR may degrade (1.05 allows 5%).
+    static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* vertices,
+                                 size_t vertexCount, size_t stride, float threshold = 1.05f);
+
+    // Renumbers vertices in first-use order and reorders the vertex data to
+    // match, so vertex fetch walks memory linearly.
+    static void optimizeVertexFetch(float* vertices, size_t vertexCount, size_t stride,
+                                    uint32_t* indices, size_t indexCount);
+
+    static VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                               unsigned cacheSize = kCacheSize);
+};
+}
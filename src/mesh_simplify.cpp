@@ -0,0 +1,232 @@
+#include "mesh_simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace gl {
+
+    namespace {
+        // Sum of squared distances to a set of planes, weighted by triangle area.
+        struct Quadric {
+            double a2 = 0, ab = 0, ac = 0, ad = 0;
+            double b2 = 0, bc = 0, bd = 0;
+            double c2 = 0, cd = 0;
+            double d2 = 0;
+            double weight = 0;
+
+            static Quadric plane(const glm::dvec3& n, double d, double w) {
+                Quadric q;
+                q.a2 = w * n.x * n.x; q.ab = w * n.x * n.y; q.ac = w * n.x * n.z; q.ad = w * n.x * d;
+                q.b2 = w * n.y * n.y; q.bc = w * n.y * n.z; q.bd = w * n.y * d;
+                q.c2 = w * n.z * n.z; q.cd = w * n.z * d;
+                q.d2 = w * d * d;
+                q.weight = w;
+                return q;
+            }
+
+            Quadric& operator+=(const Quadric& o) {
+                a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+                b2 += o.b2; bc += o.bc; bd += o.bd;
+                c2 += o.c2; cd += o.cd;
+                d2 += o.d2;
+                weight += o.weight;
+                return *this;
+            }
+
+            [[nodiscard]] double eval(const glm::dvec3& p) const {
+                double x = p.x, y = p.y, z = p.z;
+                return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                     + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                     + c2 * z * z + 2 * cd * z
+                     + d2;
+            }
+        };
+
+        struct Collapse {
+            uint32_t from;
+            uint32_t to;
+            double error; // squared distance
+        };
+
+        uint64_t edgeKey(uint32_t a, uint32_t b) {
+            return (static_cast<uint64_t>(a) << 32) | b;
+        }
+
+        struct PositionHash {
+            size_t operator()(const glm::vec3& p) const {
+                uint32_t h[3];
+                std::memcpy(h, &p, sizeof(h));
+                return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+            }
+        };
+    }
+
+    size_t MeshSimplifier::simplify(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                                    const float* vertices, size_t vertexCount, size_t stride,
+                                    size_t targetIndexCount, float targetError, float* resultError) {
+        auto position = [&](uint32_t v) {
+            const float* p = vertices + v * stride;
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+
+        std::vector<uint32_t> result(indices, indices + indexCount);
+        if (resultError) *resultError = 0.0f;
+
+        // Vertices sharing a position; more than one member means a seam.
+        std::vector<uint32_t> positionId(vertexCount);
+        std::vector<uint32_t> wedges(vertexCount, 0);
+        {
+            std::unordered_map<glm::vec3, uint32_t, PositionHash> ids;
+            for (uint32_t v : result) {
+                auto [it, inserted] = ids.emplace(position(v), v);
+                positionId[v] = it->second;
+            }
+            std::vector<bool> counted(vertexCount, false);
+            for (uint32_t v : result) {
+                if (!counted[v]) {
+                    counted[v] = true;
+                    wedges[positionId[v]]++;
+                }
+            }
+        }
+
+        // Lock seams, open borders and non-manifold edges.
+        std::vector<bool> locked(vertexCount, false);
+        {
+            std::unordered_map<uint64_t, uint32_t> edges;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t a = positionId[result[i + k]];
+                    uint32_t b = positionId[result[i + (k + 1) % 3]];
+                    edges[edgeKey(a, b)]++;
+                }
+            }
+            for (size_t i = 0; i < result.size(); i++) {
+                uint32_t v = result[i];
+                if (wedges[positionId[v]] > 1) locked[v] = true;
+            }
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t a = positionId[result[i + k]];
+                    uint32_t b = positionId[result[i + (k + 1) % 3]];
+                    if (edges.count(edgeKey(b, a)) == 0 || edges[edgeKey(a, b)] > 1) {
+                        locked[result[i + k]] = true;
+                        locked[result[i + (k + 1) % 3]] = true;
+                    }
+                }
+            }
+        }
+
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < result.size(); i += 3) {
+            glm::dvec3 p0 = position(result[i]);
+            glm::dvec3 p1 = position(result[i + 1]);
+            glm::dvec3 p2 = position(result[i + 2]);
+            glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+            double area = glm::length(n);
+            if (area == 0.0) continue;
+            n /= area;
+            Quadric q = Quadric::plane(n, -glm::dot(n, p0), area * 0.5);
+            for (size_t k = 0; k < 3; k++) quadrics[result[i + k]] += q;
+        }
+
+        const double errorLimit = static_cast<double>(targetError) * targetError;
+        double maxError = 0.0;
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<uint32_t> offsets(vertexCount + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<bool> touched(vertexCount);
+        std::vector<Collapse> collapses;
+
+        while (result.size() > targetIndexCount) {
+            // Vertex -> triangle adjacency of the current result.
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for (uint32_t v : result) offsets[v + 1]++;
+            for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+            adjacency.resize(result.size());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++) {
+                adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (size_t k = 0; k < 3; k++) {
+                    // The twin triangle contributes the opposite direction;
+                    // border edges have locked endpoints anyway.
+                    uint32_t from = result[i + k];
+                    uint32_t to = result[i + (k + 1) % 3];
+                    if (locked[from]) continue;
+                    Quadric q = quadrics[from];
+                    q += quadrics[to];
+                    double error = std::max(0.0, q.eval(position(to))) / std::max(q.weight, 1e-30);
+                    collapses.push_back({from, to, error});
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+            for (size_t v = 0; v < vertexCount; v++) remap[v] = static_cast<uint32_t>(v);
+            std::fill(touched.begin(), touched.end(), false);
+            size_t remaining = result.size();
+            size_t applied = 0;
+            for (const Collapse& c : collapses) {
+                if (c.error > errorLimit || remaining <= targetIndexCount) break;
+                if (touched[c.from] || touched[c.to]) continue;
+
+                // Reject collapses that flip or badly rotate a surviving triangle.
+                glm::vec3 target = position(c.to);
+                bool valid = true;
+                size_t removed = 0;
+                for (uint32_t a = offsets[c.from]; a < offsets[c.from + 1] && valid; a++) {
+                    const uint32_t* tri = &result[3 * adjacency[a]];
+                    if (positionId[tri[0]] == positionId[c.to] || positionId[tri[1]] == positionId[c.to]
+                        || positionId[tri[2]] == positionId[c.to]) {
+                        removed++;
+                        continue;
+                    }
+                    glm::vec3 p[3] = {position(tri[0]), position(tri[1]), position(tri[2])};
+                    glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    for (auto& q : p) {
+                        if (q == position(c.from)) q = target;
+                    }
+                    glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    valid = glm::dot(before, after) > 0.25f * glm::length(before) * glm::length(after);
+                }
+                if (!valid) continue;
+
+                remap[c.from] = c.to;
+                quadrics[c.to] += quadrics[c.from];
+                maxError = std::max(maxError, c.error);
+                remaining -= 3 * removed;
+                applied++;
+                // Freeze the one-ring so later collapses in this pass see valid geometry.
+                for (uint32_t a = offsets[c.from]; a < offsets[c.from + 1]; a++) {
+                    const uint32_t* tri = &result[3 * adjacency[a]];
+                    touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+                }
+            }
+            if (applied == 0) break;
+
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+                if (positionId[a] == positionId[b] || positionId[b] == positionId[c] || positionId[a] == positionId[c]) {
+                    continue;
+                }
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+
+        if (resultError) *resultError = static_cast<float>(std::sqrt(maxError));
+        std::copy(result.begin(), result.end(), dst);
+        return result.size();
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gl {
+
+// Quadric error metric simplification (Garland & Heckbert) by half-edge
+// collapse. Vertices are never moved or created, so every level of detail can
+// index the source vertex buffer. Vertices on open borders and on seams
+// (several vertices at one position, i.e. UV or normal discontinuities) are
+// locked, which keeps texture and shading seams intact.
+class MeshSimplifier {
+public:
+    // Simplifies the triangle list until it has at most targetIndexCount
+    // indices or the next collapse would move the surface by more than
+    // targetError (object-space distance). Writes to dst, which must hold
+    // indexCount indices, and returns the number written. resultError receives
+    // the largest deviation introduced.
+    static size_t simplify(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                           const float* vertices, size_t vertexCount, size_t stride,
+                           size_t targetIndexCount, float targetError, float* resultError = nullptr);
+};
+}
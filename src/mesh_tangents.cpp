@@ -0,0 +1,343 @@
+#include "mesh_tangents.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "simd.h"
+#include "vertex_format.h"
+
+namespace gl {
+
+    namespace {
+        // Four triangles in SoA form: corner positions and texcoords in, per-face
+        // terms out.
+        struct FaceBatch {
+            float px[3][4], py[3][4], pz[3][4];
+            float u[3][4], v[3][4];
+            float tx[4], ty[4], tz[4]; // face normal (twice the area) or tangent
+            float bx[4], by[4], bz[4]; // bitangent
+            float angle[3][4];         // interior angle at each corner
+        };
+
+        // acos to about 1e-4 radians (Abramowitz & Stegun 4.4.45), plenty for weights.
+        float acosApprox(float c) {
+            float a = std::min(std::abs(c), 1.0f);
+            float r = std::sqrt(1.0f - a) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f - 0.0187293f * a)));
+            return c < 0.0f ? 3.14159265f - r : r;
+        }
+
+#ifdef GL_SSE2
+        struct Vec4x3 {
+            __m128 x, y, z;
+        };
+
+        Vec4x3 load(const float (&x)[4], const float (&y)[4], const float (&z)[4]) {
+            return {_mm_loadu_ps(x), _mm_loadu_ps(y), _mm_loadu_ps(z)};
+        }
+
+        void store(const Vec4x3& a, float (&x)[4], float (&y)[4], float (&z)[4]) {
+            _mm_storeu_ps(x, a.x);
+            _mm_storeu_ps(y, a.y);
+            _mm_storeu_ps(z, a.z);
+        }
+
+        Vec4x3 sub(const Vec4x3& a, const Vec4x3& b) {
+            return {_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)};
+        }
+
+        Vec4x3 scale(const Vec4x3& a, __m128 s) {
+            return {_mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s)};
+        }
+
+        __m128 dot(const Vec4x3& a, const Vec4x3& b) {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+        }
+
+        Vec4x3 cross(const Vec4x3& a, const Vec4x3& b) {
+            return {_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+                    _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+                    _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))};
+        }
+
+        __m128 acosApprox(__m128 c) {
+            const __m128 signMask = _mm_set1_ps(-0.0f);
+            __m128 a = _mm_min_ps(_mm_andnot_ps(signMask, c), _mm_set1_ps(1.0f));
+            __m128 poly = _mm_add_ps(_mm_set1_ps(0.0742610f), _mm_mul_ps(a, _mm_set1_ps(-0.0187293f)));
+            poly = _mm_add_ps(_mm_set1_ps(-0.2121144f), _mm_mul_ps(a, poly));
+            poly = _mm_add_ps(_mm_set1_ps(1.5707288f), _mm_mul_ps(a, poly));
+            __m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)), poly);
+            __m128 negative = _mm_cmplt_ps(c, _mm_setzero_ps());
+            __m128 flipped = _mm_sub_ps(_mm_set1_ps(3.14159265f), r);
+            return _mm_or_ps(_mm_and_ps(negative, flipped), _mm_andnot_ps(negative, r));
+        }
+
+        // Angle between a and b, 0 when either is degenerate.
+        __m128 angleBetween(const Vec4x3& a, const Vec4x3& b) {
+            __m128 lengths = _mm_mul_ps(dot(a, a), dot(b, b));
+            __m128 valid = _mm_cmpgt_ps(lengths, _mm_setzero_ps());
+            __m128 c = _mm_div_ps(dot(a, b), _mm_sqrt_ps(_mm_max_ps(lengths, _mm_set1_ps(1e-30f))));
+            return _mm_and_ps(valid, acosApprox(c));
+        }
+
+        void cornerAngles(FaceBatch& b, const Vec4x3 p[3]) {
+            for (int k = 0; k < 3; k++) {
+                const Vec4x3& here = p[k];
+                _mm_storeu_ps(b.angle[k], angleBetween(sub(p[(k + 1) % 3], here), sub(p[(k + 2) % 3], here)));
+            }
+        }
+
+        void normalTerms(FaceBatch& b) {
+            Vec4x3 p[3];
+            for (int k = 0; k < 3; k++) p[k] = load(b.px[k], b.py[k], b.pz[k]);
+            store(cross(sub(p[1], p[0]), sub(p[2], p[0])), b.tx, b.ty, b.tz);
+            cornerAngles(b, p);
+        }
+
+        void tangentTerms(FaceBatch& b) {
+            Vec4x3 p[3];
+            for (int k = 0; k < 3; k++) p[k] = load(b.px[k], b.py[k], b.pz[k]);
+            Vec4x3 d1 = sub(p[1], p[0]);
+            Vec4x3 d2 = sub(p[2], p[0]);
+            __m128 u0 = _mm_loadu_ps(b.u[0]);
+            __m128 v0 = _mm_loadu_ps(b.v[0]);
+            __m128 t21x = _mm_sub_ps(_mm_loadu_ps(b.u[1]), u0);
+            __m128 t21y = _mm_sub_ps(_mm_loadu_ps(b.v[1]), v0);
+            __m128 t31x = _mm_sub_ps(_mm_loadu_ps(b.u[2]), u0);
+            __m128 t31y = _mm_sub_ps(_mm_loadu_ps(b.v[2]), v0);
+
+            // Faces with zero UV area contribute nothing; mirrored ones are flipped.
+            __m128 area = _mm_sub_ps(_mm_mul_ps(t21x, t31y), _mm_mul_ps(t21y, t31x));
+            __m128 positive = _mm_cmpgt_ps(area, _mm_setzero_ps());
+            __m128 negative = _mm_cmplt_ps(area, _mm_setzero_ps());
+            __m128 sign = _mm_or_ps(_mm_and_ps(positive, _mm_set1_ps(1.0f)),
+                                    _mm_and_ps(negative, _mm_set1_ps(-1.0f)));
+
+            Vec4x3 a = scale(d1, t31y);
+            Vec4x3 c = scale(d2, t21y);
+            store(scale(sub(a, c), sign), b.tx, b.ty, b.tz);
+            a = scale(d2, t21x);
+            c = scale(d1, t31x);
+            store(scale(sub(a, c), sign), b.bx, b.by, b.bz);
+            cornerAngles(b, p);
+        }
+#else
+        float angleBetween(const glm::vec3& a, const glm::vec3& b) {
+            float lengths = glm::dot(a, a) * glm::dot(b, b);
+            return lengths > 0.0f ? acosApprox(glm::dot(a, b) / std::sqrt(lengths)) : 0.0f;
+        }
+
+        void cornerAngles(FaceBatch& b, int lane, const glm::vec3 p[3]) {
+            for (int k = 0; k < 3; k++) {
+                b.angle[k][lane] = angleBetween(p[(k + 1) % 3] - p[k], p[(k + 2) % 3] - p[k]);
+            }
+        }
+
+        void normalTerms(FaceBatch& b) {
+            for (int i = 0; i < 4; i++) {
+                glm::vec3 p[3];
+                for (int k = 0; k < 3; k++) p[k] = glm::vec3(b.px[k][i], b.py[k][i], b.pz[k][i]);
+                glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+                b.tx[i] = n.x;
+                b.ty[i] = n.y;
+                b.tz[i] = n.z;
+                cornerAngles(b, i, p);
+            }
+        }
+
+        void tangentTerms(FaceBatch& b) {
+            for (int i = 0; i < 4; i++) {
+                glm::vec3 p[3];
+                for (int k = 0; k < 3; k++) p[k] = glm::vec3(b.px[k][i], b.py[k][i], b.pz[k][i]);
+                glm::vec3 d1 = p[1] - p[0];
+                glm::vec3 d2 = p[2] - p[0];
+                float t21x = b.u[1][i] - b.u[0][i];
+                float t21y = b.v[1][i] - b.v[0][i];
+                float t31x = b.u[2][i] - b.u[0][i];
+                float t31y = b.v[2][i] - b.v[0][i];
+                float area = t21x * t31y - t21y * t31x;
+                float sign = area > 0.0f ? 1.0f : area < 0.0f ? -1.0f : 0.0f;
+                glm::vec3 t = sign * (t31y * d1 - t21y * d2);
+                glm::vec3 s = sign * (t21x * d2 - t31x * d1);
+                b.tx[i] = t.x;
+                b.ty[i] = t.y;
+                b.tz[i] = t.z;
+                b.bx[i] = s.x;
+                b.by[i] = s.y;
+                b.bz[i] = s.z;
+                cornerAngles(b, i, p);
+            }
+        }
+#endif
+
+        void setCorner(FaceBatch& b, int k, int lane, const float* p) {
+            b.px[k][lane] = p[0];
+            b.py[k][lane] = p[1];
+            b.pz[k][lane] = p[2];
+        }
+
+        // Open-addressing map from (position, smoothing group) to a normal slot,
+        // doubling whenever it gets half full.
+        class NormalSlots {
+        public:
+            explicit NormalSlots(size_t expectedEntries) {
+                size_t capacity = 16;
+                while (capacity < expectedEntries * 2) capacity <<= 1;
+                m_keys.resize(capacity);
+                m_slots.assign(capacity, kEmpty);
+            }
+
+            uint32_t find(uint32_t position, uint32_t group, uint32_t next) {
+                uint64_t key = (static_cast<uint64_t>(group) << 32) | position;
+                const size_t mask = m_slots.size() - 1;
+                for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+                    if (m_slots[i] == kEmpty) {
+                        m_keys[i] = key;
+                        m_slots[i] = next;
+                        if (++m_size * 2 > m_slots.size()) grow();
+                        return next;
+                    }
+                    if (m_keys[i] == key) return m_slots[i];
+                }
+            }
+
+        private:
+            static constexpr uint32_t kEmpty = UINT32_MAX;
+
+            static size_t hash(uint64_t key) {
+                uint64_t h = key * 0x9E3779B97F4A7C15ull;
+                return static_cast<size_t>(h ^ (h >> 29));
+            }
+
+            void grow() {
+                std::vector<uint64_t> keys(m_keys.size() * 2);
+                std::vector<uint32_t> slots(m_slots.size() * 2, kEmpty);
+                const size_t mask = slots.size() - 1;
+                for (size_t j = 0; j < m_slots.size(); j++) {
+                    if (m_slots[j] == kEmpty) continue;
+                    size_t i = hash(m_keys[j]) & mask;
+                    while (slots[i] != kEmpty) i = (i + 1) & mask;
+                    keys[i] = m_keys[j];
+                    slots[i] = m_slots[j];
+                }
+                m_keys.swap(keys);
+                m_slots.swap(slots);
+            }
+
+            size_t m_size = 0;
+            std::vector<uint64_t> m_keys;
+            std::vector<uint32_t> m_slots;
+        };
+
+        // Any unit vector perpendicular to n.
+        glm::vec3 perpendicular(const glm::vec3& n) {
+            glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            return glm::normalize(glm::cross(n, axis));
+        }
+    }
+
+    std::vector<glm::vec3> MeshTangents::generateNormals(const float* positions, const uint32_t* corners,
+                                                         const uint32_t* smoothingGroups, size_t faceCount,
+                                                         uint32_t* cornerNormals) {
+        // Assign a normal to every corner: one per (position, group), or one per
+        // face for faces outside any group.
+        // A closed triangle mesh has about half as many positions as faces.
+        uint32_t slotCount = 0;
+        NormalSlots slots(faceCount / 2);
+        for (size_t f = 0; f < faceCount; f++) {
+            uint32_t group = smoothingGroups ? smoothingGroups[f] : 1;
+            if (group == 0) {
+                for (int k = 0; k < 3; k++) cornerNormals[3 * f + k] = slotCount;
+                slotCount++;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                uint32_t slot = slots.find(corners[3 * f + k], group, slotCount);
+                if (slot == slotCount) slotCount++;
+                cornerNormals[3 * f + k] = slot;
+            }
+        }
+
+        std::vector<glm::vec3> normals(slotCount, glm::vec3(0.0f));
+        FaceBatch b{};
+        for (size_t first = 0; first < faceCount; first += 4) {
+            // The last batch repeats its final face in the unused lanes.
+            int lanes = static_cast<int>(std::min<size_t>(4, faceCount - first));
+            for (int i = 0; i < 4; i++) {
+                size_t f = first + std::min(i, lanes - 1);
+                for (int k = 0; k < 3; k++) setCorner(b, k, i, positions + 3 * size_t(corners[3 * f + k]));
+            }
+            normalTerms(b);
+            for (int i = 0; i < lanes; i++) {
+                size_t f = first + i;
+                glm::vec3 n(b.tx[i], b.ty[i], b.tz[i]);
+                for (int k = 0; k < 3; k++) normals[cornerNormals[3 * f + k]] += b.angle[k][i] * n;
+            }
+        }
+        for (glm::vec3& n : normals) {
+            float length = glm::length(n);
+            n = length > 0.0f ? n / length : glm::vec3(0.0f);
+        }
+        return normals;
+    }
+
+    void MeshTangents::generateTangents(float* vertices, size_t vertexCount, size_t stride, const uint32_t* indices,
+                                        size_t indexCount) {
+        constexpr size_t kNormal = 3;
+        constexpr size_t kTexcoord = 6;
+        constexpr size_t kTangent = 8;
+        auto normalOf = [&](uint32_t v) {
+            const float* n = vertices + v * stride + kNormal;
+            return glm::vec3(n[0], n[1], n[2]);
+        };
+
+        std::vector<glm::vec3> tangents(vertexCount, glm::vec3(0.0f));
+        std::vector<glm::vec3> bitangents(vertexCount, glm::vec3(0.0f));
+        const size_t faceCount = indexCount / 3;
+        FaceBatch b{};
+        for (size_t first = 0; first < faceCount; first += 4) {
+            int lanes = static_cast<int>(std::min<size_t>(4, faceCount - first));
+            for (int i = 0; i < 4; i++) {
+                size_t f = first + std::min(i, lanes - 1);
+                for (int k = 0; k < 3; k++) {
+                    const float* v = vertices + indices[3 * f + k] * stride;
+                    setCorner(b, k, i, v);
+                    // Back to the source orientation of v.
+                    b.u[k][i] = v[kTexcoord];
+                    b.v[k][i] = 1.0f - v[kTexcoord + 1];
+                }
+            }
+            tangentTerms(b);
+
+            // Like MikkTSpace, each face adds its directions projected into the
+            // vertex's tangent plane, normalized and weighted by the corner angle.
+            for (int i = 0; i < lanes; i++) {
+                glm::vec3 t(b.tx[i], b.ty[i], b.tz[i]);
+                glm::vec3 s(b.bx[i], b.by[i], b.bz[i]);
+                for (int k = 0; k < 3; k++) {
+                    uint32_t v = indices[3 * (first + i) + k];
+                    glm::vec3 n = normalOf(v);
+                    glm::vec3 tp = t - n * glm::dot(n, t);
+                    glm::vec3 sp = s - n * glm::dot(n, s);
+                    float tl = glm::length(tp);
+                    float sl = glm::length(sp);
+                    if (tl > 0.0f) tangents[v] += (b.angle[k][i] / tl) * tp;
+                    if (sl > 0.0f) bitangents[v] += (b.angle[k][i] / sl) * sp;
+                }
+            }
+        }
+
+        for (size_t v = 0; v < vertexCount; v++) {
+            glm::vec3 n = normalOf(static_cast<uint32_t>(v));
+            float nl = glm::length(n);
+            n = nl > 0.0f ? n / nl : glm::vec3(0.0f, 0.0f, 1.0f);
+            glm::vec3 t = tangents[v] - n * glm::dot(n, tangents[v]);
+            float tl = glm::length(t);
+            t = tl > 1e-12f ? t / tl : perpendicular(n);
+            float w = glm::dot(glm::cross(n, t), bitangents[v]) < 0.0f ? -1.0f : 1.0f;
+            glm::vec2 e = VertexLayout::encodeTangent(t, w);
+            float* out = vertices + v * stride + kTangent;
+            out[0] = e.x;
+            out[1] = e.y;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace gl {
+
+// Vertex normal and tangent generation for triangle lists. Face terms are
+// computed four triangles at a time; only the accumulation into vertices is
+// scalar.
+class MeshTangents {
+public:
+    // Smooth normals for an OBJ-style mesh whose corners index shared positions
+    // (3 floats each). Faces meeting at a position are averaged when they share
+    // a smoothing group, weighted by area and corner angle; faces in group 0 keep
+    // their own face normal. smoothingGroups holds one id per face, or is null to
+    // smooth everything together. Writes the index of each corner's normal into
+    // cornerNormals (3 per face) and returns the unit normals.
+    static std::vector<glm::vec3> generateNormals(const float* positions, const uint32_t* corners,
+                                                  const uint32_t* smoothingGroups, size_t faceCount,
+                                                  uint32_t* cornerNormals);
+
+    // Per-vertex tangents in the MikkTSpace convention: tangent along +u,
+    // orthogonal to the normal, with the bitangent sign (cross(n, t) * w) in w.
+    // Vertices hold pos(3), normal(3), tex(2) and receive tangent(2) after that,
+    // encoded by VertexLayout::encodeTangent, with stride given in floats. Texcoords are stored with v flipped (1 - v),
+    // as the loader does, so tangents match maps baked against the source UVs.
+    static void generateTangents(float* vertices, size_t vertexCount, size_t stride, const uint32_t* indices,
+                                 size_t indexCount);
+};
+}
@@ -0,0 +1,145 @@
+#include "mipmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "simd.h"
+
+namespace gl {
+
+    namespace {
+        constexpr int kEncodeSteps = 4095;
+
+        // sRGB decode per byte and encode from 12-bit linear values.
+        struct SrgbTables {
+            float toLinear[256];
+            uint8_t fromLinear[kEncodeSteps + 1];
+
+            SrgbTables() {
+                for (int i = 0; i < 256; i++) {
+                    float c = i / 255.0f;
+                    toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+                for (int i = 0; i <= kEncodeSteps; i++) {
+                    float l = static_cast<float>(i) / kEncodeSteps;
+                    float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                    fromLinear[i] = static_cast<uint8_t>(std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f));
+                }
+            }
+        };
+
+        const SrgbTables& srgbTables() {
+            static const SrgbTables tables;
+            return tables;
+        }
+
+        // Channels stored as sRGB: gray or RGB, never alpha.
+        int colorChannels(int channels, bool srgb) {
+            if (!srgb) return 0;
+            return channels == 2 ? 1 : std::min(channels, 3);
+        }
+
+        // One row of 8-bit pixels as linear RGBA floats.
+        void decodeRow(const unsigned char* row, int width, int channels, int srgbChannels, float* out) {
+            const SrgbTables& t = srgbTables();
+            for (int x = 0; x < width; x++) {
+                const unsigned char* p = row + static_cast<size_t>(x) * channels;
+                float* o = out + 4 * static_cast<size_t>(x);
+                for (int c = 0; c < 4; c++) {
+                    if (c >= channels) o[c] = 0.0f;
+                    else o[c] = c < srgbChannels ? t.toLinear[p[c]] : p[c] / 255.0f;
+                }
+            }
+        }
+
+        void encodeLevel(const float* src, int channels, int srgbChannels, MipLevel& level) {
+            const SrgbTables& t = srgbTables();
+            size_t count = static_cast<size_t>(level.width) * level.height;
+            level.pixels.resize(count * channels);
+            unsigned char* out = level.pixels.data();
+            for (size_t i = 0; i < count; i++) {
+                for (int c = 0; c < channels; c++) {
+                    float v = std::clamp(src[4 * i + c], 0.0f, 1.0f);
+                    out[i * channels + c] = c < srgbChannels
+                                            ? t.fromLinear[static_cast<int>(v * kEncodeSteps + 0.5f)]
+                                            : static_cast<unsigned char>(v * 255.0f + 0.5f);
+                }
+            }
+        }
+
+        // Averages 2x2 blocks of two source rows into one output row. A one pixel
+        // wide row repeats its pixel; the last column of other odd widths is
+        // dropped, as with any plain box filter.
+        void filterRows(const float* r0, const float* r1, int width, float* out, int outWidth) {
+            for (int x = 0; x < outWidth; x++) {
+                size_t a = 4 * static_cast<size_t>(2 * x);
+                size_t b = 4 * static_cast<size_t>(std::min(2 * x + 1, width - 1));
+#ifdef GL_SSE2
+                __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(r0 + a), _mm_loadu_ps(r0 + b)),
+                                        _mm_add_ps(_mm_loadu_ps(r1 + a), _mm_loadu_ps(r1 + b)));
+                _mm_storeu_ps(out + 4 * static_cast<size_t>(x), _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+                for (int c = 0; c < 4; c++) {
+                    out[4 * x + c] = 0.25f * (r0[a + c] + r0[b + c] + r1[a + c] + r1[b + c]);
+                }
+#endif
+            }
+        }
+    }
+
+    int Mipmap::levelCount(int width, int height) {
+        int levels = 1;
+        for (int size = std::max(width, height); size > 1; size >>= 1) levels++;
+        return levels;
+    }
+
+    std::vector<MipLevel> Mipmap::generate(const unsigned char* pixels, int width, int height, int channels,
+                                           bool srgb) {
+        std::vector<MipLevel> levels;
+        if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4) return levels;
+        levels.reserve(levelCount(width, height) - 1);
+        const int srgbChannels = colorChannels(channels, srgb);
+
+        // Level 1 comes straight from the bytes, two decoded rows at a time, so
+        // the full-size image is never held as floats.
+        std::vector<float> current;
+        std::vector<float> next;
+        int w = width;
+        int h = height;
+        if (w > 1 || h > 1) {
+            int nw = std::max(1, w / 2);
+            int nh = std::max(1, h / 2);
+            std::vector<float> row0(4 * static_cast<size_t>(w));
+            std::vector<float> row1(4 * static_cast<size_t>(w));
+            size_t rowBytes = static_cast<size_t>(w) * channels;
+            current.resize(4 * static_cast<size_t>(nw) * nh);
+            for (int y = 0; y < nh; y++) {
+                decodeRow(pixels + rowBytes * (2 * y), w, channels, srgbChannels, row0.data());
+                decodeRow(pixels + rowBytes * std::min(2 * y + 1, h - 1), w, channels, srgbChannels, row1.data());
+                filterRows(row0.data(), row1.data(), w, current.data() + 4 * static_cast<size_t>(y) * nw, nw);
+            }
+            w = nw;
+            h = nh;
+            levels.push_back({w, h, {}});
+            encodeLevel(current.data(), channels, srgbChannels, levels.back());
+        }
+
+        while (w > 1 || h > 1) {
+            int nw = std::max(1, w / 2);
+            int nh = std::max(1, h / 2);
+            next.resize(4 * static_cast<size_t>(nw) * nh);
+            for (int y = 0; y < nh; y++) {
+                const float* r0 = current.data() + 4 * static_cast<size_t>(2 * y) * w;
+                const float* r1 = current.data() + 4 * static_cast<size_t>(std::min(2 * y + 1, h - 1)) * w;
+                filterRows(r0, r1, w, next.data() + 4 * static_cast<size_t>(y) * nw, nw);
+            }
+            current.swap(next);
+            w = nw;
+            h = nh;
+            levels.push_back({w, h, {}});
+            encodeLevel(current.data(), channels, srgbChannels, levels.back());
+        }
+        return levels;
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+namespace gl {
+
+// One level of a texture's mip chain, with the channel count of its source.
+struct MipLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// CPU mip chain generation with a 2x2 box filter. Filtering runs on linear RGBA
+// floats, four channels per SSE register, and every level is built from the
+// unquantized previous one.
+class Mipmap {
+public:
+    // Levels 1 and up of an 8-bit image with 1-4 interleaved channels, down to
+    // 1x1. With srgb the color channels are averaged in linear light and stored
+    // back as sRGB; alpha is always averaged as is.
+    static std::vector<MipLevel> generate(const unsigned char* pixels, int width, int height, int channels,
+                                          bool srgb);
+
+    // Number of levels in a full chain, including level 0.
+    static int levelCount(int width, int height);
+};
+}
@@ -0,0 +1,81 @@
+#include "model_loader.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "upload_ring.h"
+
+namespace gl {
+
+    std::vector<std::shared_ptr<ModelLoader::Job>> ModelLoader::jobs;
+
+    ThreadPool& ModelLoader::pool() {
+        static ThreadPool instance;
+        return instance;
+    }
+
+    void ModelLoader::request(const std::string& filename, const LoadConfig& config) {
+        auto job = std::make_shared<Job>();
+        job->filename = filename;
+        job->config = config;
+        jobs.push_back(job);
+
+        pool().submit([job] {
+            job->model = Mesh::stage_obj(job->filename, job->config);
+            job->staged.store(true, std::memory_order_release);
+        });
+    }
+
+    void ModelLoader::update(double budgetMs, size_t budgetBytes, std::vector<DataTex>& loaded) {
+        using clock = std::chrono::steady_clock;
+        const auto deadline = clock::now() + std::chrono::duration<double, std::milli>(budgetMs);
+        const size_t firstByte = UploadRing::bytesStaged();
+        auto withinBudget = [&] {
+            return clock::now() < deadline && UploadRing::bytesStaged() - firstByte < budgetBytes;
+        };
+
+        // Finish models in request order so they appear in the order they were
+        // dropped: a later model waits for every earlier one to be staged.
+        for (auto it = jobs.begin(); it != jobs.end();) {
+            Job& job = **it;
+            if (!job.staged.load(std::memory_order_acquire)) return;
+            if (!job.model.valid) {
+                std::cerr << "Failed to load model: " << job.filename << "\n";
+                it = jobs.erase(it);
+                continue;
+            }
+
+            bool more = true;
+            do {
+                more = Mesh::upload_next(job.model);
+            } while (more && withinBudget());
+            if (more) return;
+
+            if (job.model.data.m_draw_objects.empty()) {
+                std::cerr << "Model has no geometry: " << job.filename << "\n";
+            } else {
+                loaded.push_back(std::move(job.model.data));
+            }
+            it = jobs.erase(it);
+            if (!withinBudget()) return;
+        }
+    }
+
+    std::vector<ModelLoader::Progress> ModelLoader::progress() {
+        std::vector<Progress> result;
+        for (const auto& job : jobs) {
+            if (!job->staged.load(std::memory_order_acquire)) {
+                result.push_back({job->filename, "Parsing", 0.0f});
+                continue;
+            }
+            size_t total = job->model.uploadCount();
+            float fraction = total ? static_cast<float>(job->model.uploaded) / static_cast<float>(total) : 1.0f;
+            result.push_back({job->filename, "Uploading", fraction});
+        }
+        return result;
+    }
+
+    bool ModelLoader::busy() {
+        return !jobs.empty();
+    }
+}
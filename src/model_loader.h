@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "thread_pool.h"
+
+namespace gl {
+
+// Background model loading. Mesh::stage_obj (parsing, processing, texture
+// decoding) runs on a thread pool, several files at a time; the GL uploads are
+// fed to the render thread a piece at a time under a per-frame budget.
+class ModelLoader {
+public:
+    struct Progress {
+        std::string filename;
+        const char* stage;
+        float fraction;
+    };
+
+    static void request(const std::string& filename, const LoadConfig& config);
+
+    // Call once per frame on the GL thread. Uploads staged data for at most
+    // budgetMs and about budgetBytes of texture data (but always makes progress)
+    // and appends finished models to loaded.
+    static void update(double budgetMs, size_t budgetBytes, std::vector<DataTex>& loaded);
+
+    static std::vector<Progress> progress();
+    [[nodiscard]] static bool busy();
+
+private:
+    struct Job {
+        std::string filename;
+        LoadConfig config;
+        StagedModel model;
+        std::atomic<bool> staged{false}; // set by the worker once model is complete
+    };
+
+    static ThreadPool& pool();
+
+    static std::vector<std::shared_ptr<Job>> jobs; // touched by the GL thread only
+};
+}
@@ -0,0 +1,143 @@
+#include "occlusion.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "render_state.h"
+#include "shaders.h"
+#include "texture.h"
+
+namespace gl {
+
+    namespace {
+        // Objects whose bounding sphere subtends more than this (radius over
+        // distance) are drawn as occluders without a query.
+        constexpr float kOccluderSize = 0.25f;
+
+        // Unit cube as a triangle strip, scaled to each box in the vertex shader.
+        constexpr float kCubeStrip[] = {
+                0, 1, 1,  1, 1, 1,  0, 0, 1,  1, 0, 1,  1, 0, 0,  1, 1, 1,  1, 1, 0,
+                0, 1, 1,  0, 1, 0,  0, 0, 1,  0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 1, 0,
+        };
+    }
+
+    GLuint OcclusionCuller::program = 0;
+    GLuint OcclusionCuller::vao = 0;
+    GLuint OcclusionCuller::vbo = 0;
+    GLenum OcclusionCuller::target = GL_ANY_SAMPLES_PASSED;
+    GLint OcclusionCuller::mvpLocation = -1;
+    GLint OcclusionCuller::boxMinLocation = -1;
+    GLint OcclusionCuller::boxMaxLocation = -1;
+
+    void OcclusionCuller::init() {
+        GLuint vertexShader = Shader::init_shaders(GL_VERTEX_SHADER, "../res/shaders/occlusion_vertex.glsl");
+        GLuint fragmentShader = Shader::init_shaders(GL_FRAGMENT_SHADER, "../res/shaders/occlusion_fragment.glsl");
+        program = Shader::init_program(vertexShader, fragmentShader);
+        mvpLocation = Shader::uniform(program, "uMVP");
+        boxMinLocation = Shader::uniform(program, "uBoxMin");
+        boxMaxLocation = Shader::uniform(program, "uBoxMax");
+
+        // The conservative target lets the driver answer from coarse depth.
+        if (GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility) {
+            target = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+        }
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(kCubeStrip), kCubeStrip, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+        glBindVertexArray(0);
+    }
+
+    void OcclusionCuller::plan(OcclusionState& state, const std::vector<DrawObject>& objects,
+                               const std::vector<uint32_t>& candidates, const glm::vec3& eye, float nearPlane,
+                               OcclusionPlan& out) {
+        out.visible.clear();
+        out.hidden.clear();
+        out.queried.clear();
+
+        const size_t count = objects.size();
+        uint32_t current = state.frame & 1u;
+        uint32_t previous = current ^ 1u;
+        for (auto& queries : state.queries) {
+            if (queries.size() < count) {
+                size_t first = queries.size();
+                queries.resize(count);
+                glGenQueries(static_cast<GLsizei>(count - first), queries.data() + first);
+            }
+        }
+        state.issued[previous].resize(count, 0);
+        state.issued[current].assign(count, 0);
+        state.visible.resize(count, 1);
+
+        for (uint32_t i : candidates) {
+            const DrawObject& o = objects[i];
+
+            // Proxies the near plane could clip would report false occlusion.
+            glm::vec3 margin(nearPlane);
+            bool eyeInside = glm::all(glm::greaterThanEqual(eye, o.bmin - margin)) &&
+                             glm::all(glm::lessThanEqual(eye, o.bmax + margin));
+            float distance = glm::length(o.center - eye);
+            if (!o.ebo || eyeInside || o.radius > kOccluderSize * distance) {
+                out.visible.push_back(i);
+                continue;
+            }
+
+            // Objects not queried last frame (new in the frustum) count as visible.
+            bool visible = true;
+            if (state.issued[previous][i]) {
+                GLuint available = GL_FALSE;
+                glGetQueryObjectuiv(state.queries[previous][i], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available) {
+                    GLuint passed = 0;
+                    glGetQueryObjectuiv(state.queries[previous][i], GL_QUERY_RESULT, &passed);
+                    state.visible[i] = passed != 0;
+                }
+                visible = state.visible[i] != 0;
+            }
+            state.visible[i] = visible;
+            (visible ? out.visible : out.hidden).push_back(i);
+            out.queried.push_back(i);
+        }
+    }
+
+    void OcclusionCuller::query(OcclusionState& state, const std::vector<DrawObject>& objects,
+                                const OcclusionPlan& plan, const glm::mat4& mvp) {
+        uint32_t current = state.frame & 1u;
+        RenderState::useProgram(program);
+        glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+        RenderState::bindVertexArray(vao);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        RenderState::depthMask(false);
+        RenderState::disable(GL_POLYGON_OFFSET_FILL);
+        RenderState::polygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        for (uint32_t i : plan.queried) {
+            const DrawObject& o = objects[i];
+            glUniform3fv(boxMinLocation, 1, glm::value_ptr(o.bmin));
+            glUniform3fv(boxMaxLocation, 1, glm::value_ptr(o.bmax));
+            glBeginQuery(target, state.queries[current][i]);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 14);
+            glEndQuery(target);
+            state.issued[current][i] = 1;
+        }
+        state.frame++;
+    }
+
+    void OcclusionCuller::restore() {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        RenderState::depthMask(true);
+        RenderState::enable(GL_POLYGON_OFFSET_FILL);
+    }
+
+    void OcclusionCuller::beginConditional(const OcclusionState& state, uint32_t i) {
+        // query() advanced the frame, so this frame's queries are the previous set.
+        uint32_t issuedSet = (state.frame & 1u) ^ 1u;
+        glBeginConditionalRender(state.queries[issuedSet][i], GL_QUERY_WAIT);
+    }
+
+    void OcclusionCuller::endConditional() {
+        glEndConditionalRender();
+    }
+}
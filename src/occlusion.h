@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+struct DrawObject;
+
+namespace gl {
+
+// Per-model occlusion query state. Queries are double-buffered by frame so the
+// results read in one frame were issued in the previous one.
+struct OcclusionState {
+    std::vector<GLuint> queries[2];
+    std::vector<uint8_t> issued[2];
+    std::vector<uint8_t> visible; // last known result per object
+    uint32_t frame = 0;
+};
+
+// How the objects that passed frustum culling are drawn this frame.
+struct OcclusionPlan {
+    std::vector<uint32_t> visible; // occluders and objects visible last frame, drawn normally
+    std::vector<uint32_t> hidden;  // occluded last frame, drawn under conditional rendering
+    std::vector<uint32_t> queried; // every object that gets a proxy query this frame
+};
+
+// Hardware occlusion culling with proxy boxes. Large or nearby objects are
+// drawn as occluders; every other object gets an any-samples-passed query on
+// its bounding box after the visible set is drawn. The result decides whether
+// the object is drawn normally next frame; until then it is drawn through
+// conditional rendering, so the CPU never waits for a query.
+class OcclusionCuller {
+public:
+    // Creates the proxy box program and geometry. Needs a GL context.
+    static void init();
+    [[nodiscard]] static bool ready() { return program != 0; }
+
+    // Reads last frame's results without stalling and sorts candidates, in the
+    // data's object space with eye the camera position in that space.
+    static void plan(OcclusionState& state, const std::vector<DrawObject>& objects,
+                     const std::vector<uint32_t>& candidates, const glm::vec3& eye, float nearPlane,
+                     OcclusionPlan& out);
+    // Issues the proxy box queries of plan.queried against the current depth
+    // buffer. Leaves the proxy program bound and color/depth writes disabled
+    // until restore().
+    static void query(OcclusionState& state, const std::vector<DrawObject>& objects, const OcclusionPlan& plan,
+                      const glm::mat4& mvp);
+    static void restore();
+
+    // Wraps drawing object i in conditional rendering on this frame's query.
+    static void beginConditional(const OcclusionState& state, uint32_t i);
+    static void endConditional();
+
+private:
+    static GLuint program;
+    static GLuint vao;
+    static GLuint vbo;
+    static GLenum target;
+    static GLint mvpLocation;
+    static GLint boxMinLocation;
+    static GLint boxMaxLocation;
+};
+}
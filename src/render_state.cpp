@@ -0,0 +1,168 @@
+#include "render_state.h"
+
+#include <cmath>
+#include <iterator>
+
+namespace gl {
+
+    namespace {
+        // Shadow value that matches nothing GL can hold, so the next set goes through.
+        constexpr GLuint kUnknown = ~0u;
+        constexpr GLuint kTextureUnits = 32;
+        constexpr GLenum kTargets[] = {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP};
+        constexpr size_t kTargetCount = std::size(kTargets);
+        constexpr GLenum kCapabilities[] = {GL_DEPTH_TEST, GL_BLEND, GL_POLYGON_OFFSET_FILL, GL_CULL_FACE};
+        constexpr size_t kCapabilityCount = std::size(kCapabilities);
+
+        struct Shadow {
+            GLuint program;
+            GLuint vao;
+            GLuint activeUnit;
+            GLuint textures[kTextureUnits][kTargetCount];
+            int capabilities[kCapabilityCount]; // 0 off, 1 on, -1 unknown
+            GLenum blendSrc, blendDst;
+            GLenum depthFunc;
+            int depthMask;
+            GLenum polygonMode;
+            float offsetFactor, offsetUnits; // NaN compares unequal to everything
+        };
+
+        Shadow unknownShadow() {
+            Shadow s;
+            s.program = kUnknown;
+            s.vao = kUnknown;
+            s.activeUnit = kUnknown;
+            for (auto& unit : s.textures) {
+                for (GLuint& texture : unit) texture = kUnknown;
+            }
+            for (int& on : s.capabilities) on = -1;
+            s.blendSrc = s.blendDst = kUnknown;
+            s.depthFunc = kUnknown;
+            s.depthMask = -1;
+            s.polygonMode = kUnknown;
+            s.offsetFactor = s.offsetUnits = NAN;
+            return s;
+        }
+
+        Shadow shadow = unknownShadow();
+
+        // Position of value in values, or N when absent.
+        template <size_t N>
+        size_t indexOf(const GLenum (&values)[N], GLenum value) {
+            for (size_t i = 0; i < N; i++) {
+                if (values[i] == value) return i;
+            }
+            return N;
+        }
+
+        // Records a set and says whether it needs to reach GL.
+        bool changed(bool differs) {
+            (differs ? RenderState::stats.issued : RenderState::stats.elided)++;
+            return differs;
+        }
+    }
+
+    RenderStateStats RenderState::stats;
+
+    void RenderState::beginFrame() {
+        stats = {};
+        invalidate();
+    }
+
+    void RenderState::invalidate() {
+        shadow = unknownShadow();
+    }
+
+    void RenderState::useProgram(GLuint program) {
+        if (changed(shadow.program != program)) {
+            glUseProgram(program);
+            shadow.program = program;
+        }
+    }
+
+    void RenderState::bindVertexArray(GLuint vao) {
+        if (changed(shadow.vao != vao)) {
+            glBindVertexArray(vao);
+            shadow.vao = vao;
+        }
+    }
+
+    void RenderState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+        size_t slot = indexOf(kTargets, target);
+        bool shadowed = unit < kTextureUnits && slot < kTargetCount;
+        if (shadowed && !changed(shadow.textures[unit][slot] != texture)) return;
+        if (changed(shadow.activeUnit != unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            shadow.activeUnit = unit;
+        }
+        glBindTexture(target, texture);
+        if (shadowed) {
+            shadow.textures[unit][slot] = texture;
+        } else {
+            stats.issued++;
+        }
+    }
+
+    void RenderState::setCapability(GLenum cap, bool on) {
+        size_t slot = indexOf(kCapabilities, cap);
+        if (slot < kCapabilityCount) {
+            if (!changed(shadow.capabilities[slot] != static_cast<int>(on))) return;
+            shadow.capabilities[slot] = on;
+        } else {
+            stats.issued++;
+        }
+        on ? glEnable(cap) : glDisable(cap);
+    }
+
+    void RenderState::enable(GLenum cap) {
+        setCapability(cap, true);
+    }
+
+    void RenderState::disable(GLenum cap) {
+        setCapability(cap, false);
+    }
+
+    void RenderState::blendFunc(GLenum src, GLenum dst) {
+        if (changed(shadow.blendSrc != src || shadow.blendDst != dst)) {
+            glBlendFunc(src, dst);
+            shadow.blendSrc = src;
+            shadow.blendDst = dst;
+        }
+    }
+
+    void RenderState::depthFunc(GLenum func) {
+        if (changed(shadow.depthFunc != func)) {
+            glDepthFunc(func);
+            shadow.depthFunc = func;
+        }
+    }
+
+    void RenderState::depthMask(bool write) {
+        if (changed(shadow.depthMask != static_cast<int>(write))) {
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+            shadow.depthMask = write;
+        }
+    }
+
+    void RenderState::polygonMode(GLenum face, GLenum mode) {
+        // Core profiles only take GL_FRONT_AND_BACK; any other face leaves the two sides apart.
+        if (face != GL_FRONT_AND_BACK) {
+            stats.issued++;
+            glPolygonMode(face, mode);
+            shadow.polygonMode = kUnknown;
+            return;
+        }
+        if (changed(shadow.polygonMode != mode)) {
+            glPolygonMode(face, mode);
+            shadow.polygonMode = mode;
+        }
+    }
+
+    void RenderState::polygonOffset(float factor, float units) {
+        if (changed(shadow.offsetFactor != factor || shadow.offsetUnits != units)) {
+            glPolygonOffset(factor, units);
+            shadow.offsetFactor = factor;
+            shadow.offsetUnits = units;
+        }
+    }
+}
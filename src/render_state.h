@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <GL/glew.h>
+
+namespace gl {
+
+struct RenderStateStats {
+    size_t issued = 0; // GL calls forwarded to the driver
+    size_t elided = 0; // calls dropped because the state was already set
+};
+
+// Shadow of the GL state the draw paths set over and over: program, vertex
+// array, texture bindings, capabilities, blend function, polygon mode and
+// offset. Each setter forwards to GL only when the value differs from the
+// shadow. Code that changes this state directly, such as uploads and ImGui,
+// runs outside the frame's draws; beginFrame forgets the shadow so the first
+// setter of each kind always reaches GL.
+class RenderState {
+public:
+    // Forgets the shadowed state and resets stats. Call before the frame's draws.
+    static void beginFrame();
+    static void invalidate();
+
+    static void useProgram(GLuint program);
+    static void bindVertexArray(GLuint vao);
+    // Binds texture to target on unit, switching the active unit only when needed.
+    static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    // GL_DEPTH_TEST, GL_BLEND, GL_POLYGON_OFFSET_FILL and GL_CULL_FACE are
+    // shadowed; other capabilities are always forwarded.
+    static void enable(GLenum cap);
+    static void disable(GLenum cap);
+    static void blendFunc(GLenum src, GLenum dst);
+    static void depthFunc(GLenum func);
+    static void depthMask(bool write);
+    static void polygonMode(GLenum face, GLenum mode);
+    static void polygonOffset(float factor, float units);
+
+    static RenderStateStats stats;
+
+private:
+    static void setCapability(GLenum cap, bool on);
+};
+}
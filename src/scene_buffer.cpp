@@ -0,0 +1,84 @@
+#include "scene_buffer.h"
+
+#include <algorithm>
+
+namespace gl {
+
+    namespace {
+        // Smallest allocation per buffer, so small models don't trigger a chain of regrowths.
+        constexpr size_t kMinCapacity = 4 << 20;
+    }
+
+    std::array<SceneBuffer::Pool, static_cast<size_t>(VertexFormat::Count)> SceneBuffer::pools;
+
+    SceneBuffer::Pool& SceneBuffer::pool(VertexFormat format) {
+        Pool& p = pools[static_cast<size_t>(format)];
+        if (p.vao) return p;
+
+        glGenVertexArrays(1, &p.vao);
+        glGenBuffers(1, &p.vbo);
+        glGenBuffers(1, &p.ebo);
+        glBindVertexArray(p.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, p.vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, p.ebo);
+        VertexLayout::setAttributes(format);
+
+        glBindVertexArray(0);
+        return p;
+    }
+
+    // Grows a buffer in place. The name is kept so the VAO bindings stay valid;
+    // the old contents are parked in a scratch buffer while the storage is
+    // re-specified. Uses the copy targets so no VAO state is touched.
+    void SceneBuffer::reserve(GLuint buffer, size_t used, size_t& capacity, size_t required) {
+        if (required <= capacity) return;
+        size_t newCapacity = std::max({required, capacity * 2, kMinCapacity});
+
+        GLuint scratch = 0;
+        if (used > 0) {
+            glGenBuffers(1, &scratch);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+            glBufferData(GL_COPY_WRITE_BUFFER, used, nullptr, GL_STREAM_COPY);
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+        if (used > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+            glDeleteBuffers(1, &scratch);
+        }
+        capacity = newCapacity;
+    }
+
+    SceneAllocation SceneBuffer::allocate(VertexFormat format, const void* vertices, size_t vertexCount,
+                                          const void* indices, size_t indexCount, GLenum indexType) {
+        Pool& p = pool(format);
+        size_t vertexSize = VertexLayout::stride(format);
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+
+        SceneAllocation a;
+        a.vao = p.vao;
+        a.vbo = p.vbo;
+        a.ebo = p.ebo;
+        a.baseVertex = static_cast<GLint>(p.vertexBytes / vertexSize);
+        a.indexOffset = (p.indexBytes + indexSize - 1) / indexSize * indexSize;
+
+        size_t vertexBytes = vertexCount * vertexSize;
+        reserve(p.vbo, p.vertexBytes, p.vertexCapacity, p.vertexBytes + vertexBytes);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, p.vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, p.vertexBytes, vertexBytes, vertices);
+        p.vertexBytes += vertexBytes;
+
+        size_t indexBytes = indexCount * indexSize;
+        reserve(p.ebo, p.indexBytes, p.indexCapacity, a.indexOffset + indexBytes);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, p.ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, a.indexOffset, indexBytes, indices);
+        p.indexBytes = a.indexOffset + indexBytes;
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return a;
+    }
+}
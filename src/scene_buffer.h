@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "vertex_format.h"
+
+namespace gl {
+
+// Where an object's geometry landed inside the shared buffers.
+struct SceneAllocation {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    GLint baseVertex = 0;   // added to every index by the draw call
+    size_t indexOffset = 0; // byte offset of the first index in ebo
+};
+
+// Large shared vertex/index buffers holding the geometry of every loaded model,
+// with one VAO per vertex format. Objects are appended and addressed through a
+// base vertex and an index offset, so a whole scene draws from a single VAO.
+// 16- and 32-bit index ranges share one index buffer, each aligned to its size.
+class SceneBuffer {
+public:
+    static SceneAllocation allocate(VertexFormat format, const void* vertices, size_t vertexCount,
+                                    const void* indices, size_t indexCount, GLenum indexType);
+
+private:
+    struct Pool {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        size_t vertexBytes = 0;
+        size_t vertexCapacity = 0;
+        size_t indexBytes = 0;
+        size_t indexCapacity = 0;
+    };
+
+    static Pool& pool(VertexFormat format);
+    static void reserve(GLuint buffer, size_t used, size_t& capacity, size_t required);
+
+    static std::array<Pool, static_cast<size_t>(VertexFormat::Count)> pools;
+};
+}
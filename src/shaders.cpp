@@ -1,11 +1,15 @@
 
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 
 #include <GL/glew.h>
 
 #include "shaders.h"
+#include "uniform_buffers.h"
 namespace gl {
+std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> Shader::uniforms;
+
 std::string Shader::read_text_file(const char * filename) {
     std::string line;
     std::string content;
@@ -75,6 +79,42 @@ GLuint Shader::init_program (GLuint vertexshader, GLuint fragmentshader){
         program_errors(program);
         throw std::runtime_error("Shader program did not link correctly!");
     }
+    reflect(program);
     return program;
 }
+
+void Shader::reflect (GLuint program){
+    const std::pair<const char*, GLuint> blocks[] = {{"Frame", FrameBlock}, {"Material", MaterialBlock}};
+    for (const auto& [name, binding] : blocks) {
+        GLuint index = glGetUniformBlockIndex(program, name);
+        if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+    }
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    auto& table = uniforms[program];
+    table.clear();
+    std::string name(static_cast<size_t>(std::max(maxLength, 1)), '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        glGetActiveUniformName(program, static_cast<GLuint>(i), maxLength, &length, &name[0]);
+        std::string uniformName(name.data(), static_cast<size_t>(length));
+        // Block members have no location.
+        GLint location = glGetUniformLocation(program, uniformName.c_str());
+        if (location < 0) continue;
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            uniformName.resize(uniformName.size() - 3);
+        }
+        table[uniformName] = location;
+    }
+}
+
+GLint Shader::uniform (GLuint program, const std::string& name){
+    auto table = uniforms.find(program);
+    if (table == uniforms.end()) return -1;
+    auto it = table->second.find(name);
+    return it != table->second.end() ? it->second : -1;
+}
 }
\ No newline at end of file
@@ -2,16 +2,27 @@
 
 #include <iostream>
 #include <string>
+#include <unordered_map>
 
 namespace gl {
 class Shader{
 public:
     
     static GLuint init_shaders (GLenum type, const char * filename);
+    // Links the program, binds its Frame and Material uniform blocks to their
+    // binding points and records the locations of its active uniforms.
     static GLuint init_program (GLuint vertexshader, GLuint fragmentshader);
 
+    // Location recorded at link time, -1 for names the program does not use.
+    // Arrays are found by their plain name. Look up once and keep the result
+    // rather than calling this per draw.
+    static GLint uniform (GLuint program, const std::string& name);
+
 private:
     static std::string read_text_file(const char * filename);
+    static void reflect (GLuint program);
+
+    static std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> uniforms;
 
     static void program_errors (GLint program);
     static void shader_errors (GLint shader);
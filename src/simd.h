@@ -0,0 +1,8 @@
+#pragma once
+
+// GL_SSE2 is defined when the target has SSE2, which every x86-64 build does;
+// code using it keeps a scalar path for other targets.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GL_SSE2 1
+#endif
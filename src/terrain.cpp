@@ -1,14 +1,32 @@
 // terrain.cpp
 #include "terrain.h"
 #include "mesh.h"
+#include "render_state.h"
+#include "thread_pool.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
+#include <filesystem>
 
 namespace gl {
 
+namespace {
+    // One skybox at a time; each decode spreads its six faces over the texture
+    // decode workers.
+    ThreadPool& skyboxPool() {
+        static ThreadPool instance(1);
+        return instance;
+    }
+}
+
 Terrain::~Terrain() {
     glDeleteProgram(program_);
     glDeleteProgram(skyProgram_);
+    for (auto& sky : skyboxes_) {
+        sky->cancelled = true;
+        glDeleteTextures(1, &sky->texture);
+    }
 }
 
 void Terrain::generate(const std::string& dir) {
@@ -32,9 +50,12 @@ void Terrain::generate(const std::string& dir) {
     GLuint sky_vs = Shader::init_shaders(GL_VERTEX_SHADER, skyVert);
     GLuint sky_fs = Shader::init_shaders(GL_FRAGMENT_SHADER, skyFrag);
     skyProgram_ = Shader::init_program(sky_vs, sky_fs);
-    initSky(dir);
+    glUniform1i(Shader::uniform(skyProgram_, "uSkybox"), 0);
+    initSky();
 
-    setSkybox("Clouds", "../data/");
+    compressSkyboxes_ = Texture::SupportsCompression();
+    setSkybox("Clouds", dir);
+    prefetchSkyboxes(dir);
 }
 
 void Terrain::regenerate() {
@@ -43,21 +64,7 @@ void Terrain::regenerate() {
     createGeometry();
 }
 
-void Terrain::initSky(const std::string& dir) {
-    // compile sky shaders
-
-    std::string base = dir + "Skyboxes/" + skyboxName_ + "/";
-    std::cout << base << std::endl;
-    std::vector<std::string> faces = {
-        base + "right.jpg",
-        base + "left.jpg",
-        base + "top.jpg",
-        base + "bottom.jpg",
-        base + "front.jpg",
-        base + "back.jpg"
-    };
-    loc_.uSkybox = Texture::LoadCubemap(faces);
-
+void Terrain::initSky() {
     // generate inverted-sphere mesh
     std::vector<float> verts;
     std::vector<uint32_t> indices;
@@ -103,43 +110,121 @@ void Terrain::initSky(const std::string& dir) {
     glBindVertexArray(0);
 }
 
+std::shared_ptr<Terrain::Skybox> Terrain::skybox(const std::string& name) {
+    for (auto& sky : skyboxes_) {
+        if (sky->name == name) return sky;
+    }
+    auto sky = std::make_shared<Skybox>();
+    sky->name = name;
+    skyboxes_.push_back(sky);
+    return sky;
+}
+
+void Terrain::decodeSkybox(Skybox& sky, const std::string& dir, bool compress) {
+    std::string base = dir + "Skyboxes/" + sky.name + "/";
+    std::vector<std::string> faces = {
+        base + "right.jpg",
+        base + "left.jpg",
+        base + "top.jpg",
+        base + "bottom.jpg",
+        base + "front.jpg",
+        base + "back.jpg"
+    };
+    Texture::DecodeCubemap(faces, sky.faces, compress);
+    sky.decoded.store(true, std::memory_order_release);
+}
+
+void Terrain::uploadSkybox(Skybox& sky) {
+    if (sky.faces.size() == 6) sky.texture = Texture::UploadCubemap(sky.faces);
+    sky.faces.clear();
+    sky.faces.shrink_to_fit();
+}
+
+// Queues every skybox directory for decoding in the background, so switching
+// to one later is only a handle swap.
+void Terrain::prefetchSkyboxes(const std::string& dir) {
+    std::error_code ec;
+    std::vector<std::string> names;
+    for (const auto& entry : std::filesystem::directory_iterator(dir + "Skyboxes", ec)) {
+        if (entry.is_directory(ec)) names.push_back(entry.path().filename().string());
+    }
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& name : names) {
+        std::shared_ptr<Skybox> job = skybox(name);
+        if (job->decoded) continue;
+        bool compress = compressSkyboxes_;
+        skyboxPool().submit([job, dir, compress] {
+            if (job->cancelled) return;
+            std::lock_guard lock(job->mutex);
+            if (!job->decoded) decodeSkybox(*job, dir, compress);
+        });
+    }
+}
+
+void Terrain::updateSkyboxes() {
+    for (auto& sky : skyboxes_) {
+        if (sky->texture || !sky->decoded.load(std::memory_order_acquire) || sky->faces.empty()) continue;
+        uploadSkybox(*sky);
+        return;
+    }
+}
+
 void Terrain::setSkybox(const std::string& name, const std::string& dir) {
     skyboxName_ = name;
-    // delete old cubemap if needed
-    glDeleteTextures(1, (GLuint*)&loc_.uSkybox);
-    initSky(dir);
+    std::shared_ptr<Skybox> sky = skybox(name);
+    if (!sky->texture) {
+        {
+            // Waits for the prefetch if it is decoding this one right now.
+            std::lock_guard lock(sky->mutex);
+            if (!sky->decoded) decodeSkybox(*sky, dir, compressSkyboxes_);
+        }
+        uploadSkybox(*sky);
+    }
+    loc_.uSkybox = static_cast<GLint>(sky->texture);
 }
 
 
 void Terrain::createGeometry() {
-    GLsizei stride = (3+3+2)*sizeof(float);
+    const std::vector<float>& verts = quad_.getData();
+    const size_t stride = VertexLayout::floats_per_vertex;
+    size_t vertexCount = verts.size() / stride;
+
+    DataTex dt;
+    dt.format = vertexFormat_;
+    glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        glm::vec3 p(verts[stride*i], verts[stride*i+1], verts[stride*i+2]);
+        bmin = glm::min(bmin, p);
+        bmax = glm::max(bmax, p);
+    }
+    dt.quantization = VertexLayout::quantization(dt.format, bmin, bmax);
+    std::vector<unsigned char> packed = VertexLayout::pack(dt.format, verts.data(), vertexCount, dt.quantization);
+
     GLuint vao, vbo;
     glGenVertexArrays(1,&vao);
     glBindVertexArray(vao);
     glGenBuffers(1,&vbo);
     glBindBuffer(GL_ARRAY_BUFFER,vbo);
-    glBufferData(GL_ARRAY_BUFFER, quad_.getSize()*sizeof(float), quad_.getData().data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,stride,(void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,stride,(void*)(3*sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2,2,GL_FLOAT,GL_FALSE,stride,(void*)(6*sizeof(float)));
+    glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+    VertexLayout::setAttributes(dt.format);
     glBindVertexArray(0);
 
-    DataTex dt;
     DrawObject o{};
     o.vao = vao;
     o.vbo = vbo;
-    o.numTriangles = quad_.getSize()/(stride/sizeof(float))/3;
-    dt.m_draw_objects.push_back(o);
+    o.numTriangles = vertexCount/3;
+    o.bmin = bmin;
+    o.bmax = bmax;
+    o.center = 0.5f * (bmin + bmax);
+    o.radius = 0.5f * glm::length(bmax - bmin);
+    dt.addObject(o);
     m_data_.push_back(dt);
 }
 
 void Terrain::cacheUniformLocations() {
-    auto L = [&](const char* n){ return glGetUniformLocation(program_, n); };
+    auto L = [&](const char* n){ return Shader::uniform(program_, n); };
     loc_.uModel       = L("uModel");
-    loc_.uViewProj    = L("uViewProj");
     loc_.uHeightTex   = L("uHeightTex");
     loc_.uHeightScale = L("uHeightScale");
     loc_.uTexel       = L("uTexel");
@@ -148,42 +233,42 @@ void Terrain::cacheUniformLocations() {
     loc_.uRockLine    = L("uRockLine");
     loc_.uSnowLine    = L("uSnowLine");
 
-    loc_.uSunDir      = L("uSunDir");
-    loc_.uSunColor    = L("uSunColor");
-    loc_.uAmbient     = L("uAmbient");
+    loc_.uUVScale = L("uUVScale");
+    loc_.uBlendW  = L("uBlendW");
+}
 
-    loc_.uUVScale = glGetUniformLocation(program_, "uUVScale");
-    loc_.uBlendW  = glGetUniformLocation(program_, "uBlendW");
+void Terrain::fillFrame(FrameUniforms& frame) const {
+    frame.sunDir   = glm::vec4(sunDir_, 0.0f);
+    frame.sunColor = glm::vec4(sunColor_, 1.0f);
+    frame.ambient  = glm::vec4(ambientColor_, 1.0f);
+}
+
+void Terrain::applyFiltering() const {
+    if (heightMap_) Texture::ApplyFiltering(heightMap_);
+    for (const auto& sky : skyboxes_) {
+        if (sky->texture) Texture::ApplyFiltering(sky->texture, GL_TEXTURE_CUBE_MAP);
+    }
 }
 
 void Terrain::loadTextures(std::string d) {
-    heightMap_ = Texture::LoadTexture(d, "heightmap.jpg");
+    heightMap_ = Texture::LoadTexture(d, "heightmap.jpg", TextureKind::Data);
 }
 
 void Terrain::render(int mode) {
     // draw sky
-    glDepthFunc(GL_LEQUAL);
-    glDepthMask(GL_FALSE);
-    glUseProgram(skyProgram_);
-    glm::mat4 view = Camera::getViewMatrix();
-    glm::mat4 proj = Camera::getProjection(1920.f/1080.f);
-    glm::mat4 skyVP = proj * glm::mat4(glm::mat3(view));
-    glUniformMatrix4fv(glGetUniformLocation(skyProgram_,"uViewProj"),1,GL_FALSE,&skyVP[0][0]);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, loc_.uSkybox);
-    glUniform1i(glGetUniformLocation(skyProgram_,"uSkybox"),0);
-    glBindVertexArray(skyVAO_);
+    RenderState::depthFunc(GL_LEQUAL);
+    RenderState::depthMask(false);
+    RenderState::useProgram(skyProgram_);
+    RenderState::bindTexture(0, GL_TEXTURE_CUBE_MAP, loc_.uSkybox);
+    RenderState::bindVertexArray(skyVAO_);
     glDrawElements(GL_TRIANGLE_STRIP, skyIndexCount_, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-    glDepthMask(GL_TRUE);
-    glDepthFunc(GL_LESS);
+    RenderState::depthMask(true);
+    RenderState::depthFunc(GL_LESS);
 
     // draw terrain
-    glUseProgram(program_);
+    RenderState::useProgram(program_);
     glm::mat4 model = glm::mat4(1.0f);
-    glm::mat4 viewProj = proj * view;
 
-    glUniformMatrix4fv(loc_.uViewProj,1,GL_FALSE,&viewProj[0][0]);
     glUniformMatrix4fv(loc_.uModel,1,GL_FALSE,&model[0][0]);
 
     // apply tweakable parameters
@@ -196,12 +281,7 @@ void Terrain::render(int mode) {
     glUniform1f(loc_.uSnowLine,     snowLine_);
     glUniform1f(loc_.uBlendW, blendWidth_);
 
-    glUniform3fv(loc_.uSunDir,      1, glm::value_ptr(sunDir_));
-    glUniform3fv(loc_.uSunColor,    1, glm::value_ptr(sunColor_));
-    glUniform3fv(loc_.uAmbient,     1, glm::value_ptr(ambientColor_));
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, heightMap_);
+    RenderState::bindTexture(0, GL_TEXTURE_2D, heightMap_);
     glUniform1i(loc_.uHeightTex, 0);
 
     auto& data = m_data_.front();
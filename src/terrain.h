@@ -1,6 +1,9 @@
 // terrain.h
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
@@ -9,6 +12,7 @@
 #include "texture.h"
 #include "shaders.h"
 #include "camera.h"
+#include "uniform_buffers.h"
 
 namespace gl {
 
@@ -18,9 +22,17 @@ struct Terrain {
 
     // initialize shaders, geometry, textures, sky
     void generate(const std::string& dir);
-    void initSky(const std::string& dir);
+    void initSky();
+    // Swaps in a skybox from dir/Skyboxes/name, decoding it first if the
+    // background prefetch has not got to it yet.
     void setSkybox(const std::string& name, const std::string& dir);
+    // Uploads one skybox the prefetch has decoded; call once per frame.
+    void updateSkyboxes();
     void render(int mode);
+    // Sun and ambient light, which the terrain shaders read from the Frame block.
+    void fillFrame(FrameUniforms& frame) const;
+    // Reapplies Texture::filtering to the heightmap and the uploaded skyboxes.
+    void applyFiltering() const;
 
     // —– tweakable parameters exposed to ImGui —–
     float       width_        = 100.f;
@@ -42,6 +54,8 @@ struct Terrain {
 
     std::string skyboxName_;
 
+    VertexFormat vertexFormat_ = VertexFormat::Float32; // applied on regenerate()
+
     // rebuild mesh when geometry parameters change
     void regenerate();
 
@@ -57,16 +71,12 @@ private:
 
     struct UniformLocs {
         GLint uModel;
-        GLint uViewProj;
         GLint uHeightTex;
         GLint uHeightScale;
         GLint uTexel;
         GLint uWaterLevel;
         GLint uRockLine;
         GLint uSnowLine;
-        GLint uSunDir;
-        GLint uSunColor;
-        GLint uAmbient;
         GLint uSkybox;
         GLint uUVScale;
         GLint uBlendW;
@@ -74,6 +84,23 @@ private:
 
     std::vector<DataTex>    m_data_;
 
+    // A cubemap decoded on a worker thread and uploaded on the GL thread.
+    struct Skybox {
+        std::string name;
+        std::mutex mutex;                 // held while decoding
+        std::atomic<bool> decoded{false}; // faces are set, or the decode failed
+        std::atomic<bool> cancelled{false};
+        std::vector<TextureImage> faces;  // released once uploaded
+        GLuint texture = 0;
+    };
+    std::vector<std::shared_ptr<Skybox>> skyboxes_;
+    bool compressSkyboxes_ = false;
+
+    std::shared_ptr<Skybox> skybox(const std::string& name);
+    void prefetchSkyboxes(const std::string& dir);
+    static void decodeSkybox(Skybox& sky, const std::string& dir, bool compress);
+    static void uploadSkybox(Skybox& sky);
+
     void createGeometry();
     void cacheUniformLocations();
     void loadTextures(std::string dir);
@@ -1,6 +1,21 @@
 #include "texture.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
 #include <GL/glew.h>
+#include "mapped_file.h"
+#include "render_state.h"
+#include "shaders.h"
+#include "texture_cache.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "upload_ring.h"
 #include "tiny_obj_loader.h"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -8,46 +23,241 @@
 
 namespace gl {
 
-    void Texture::LoadMaterials(const std::vector<tinyobj::material_t>& materials, std::string& filename, DataTex& data) {
-        for (const auto& mat : materials) {
-            if (!mat.ambient_texname.empty()) LoadTexture(filename, mat.ambient_texname, data);
-            if (!mat.diffuse_texname.empty()) LoadTexture(filename, mat.diffuse_texname, data);
-            if (!mat.specular_texname.empty()) LoadTexture(filename, mat.specular_texname, data);
-            if (!mat.specular_highlight_texname.empty()) LoadTexture(filename, mat.specular_highlight_texname, data);
-            if (!mat.bump_texname.empty()) LoadTexture(filename, mat.bump_texname, data);
-            if (!mat.alpha_texname.empty()) LoadTexture(filename, mat.alpha_texname, data);
-            if (!mat.reflection_texname.empty()) LoadTexture(filename, mat.reflection_texname, data);
+    namespace {
+        struct DecodeJob {
+            std::string texname;
+            TextureKind kind;
+        };
+
+        struct SlotInfo {
+            std::string texture_names::* name;
+            TextureKind kind;
+        };
+
+        // Indexed by MaterialSlot.
+        constexpr SlotInfo kSlots[MaterialSlotCount] = {
+                {&texture_names::ambient_texname, TextureKind::Color},
+                {&texture_names::diffuse_texname, TextureKind::Color},
+                {&texture_names::specular_texname, TextureKind::Color},
+                {&texture_names::specular_highlight_texname, TextureKind::Data},
+                {&texture_names::bump_texname, TextureKind::Normal},
+                {&texture_names::reflection_texname, TextureKind::Color},
+                {&texture_names::alpha_texname, TextureKind::Data},
+        };
+
+        // Units that hold one array for the whole model. A model with more arrays
+        // than units keeps the last MaterialSlotCount units for per-material binds,
+        // one per slot, so the slots of one material never compete for a unit.
+        int sharedUnits(const DataTex& data) {
+            if (data.textureArrays.size() <= static_cast<size_t>(Texture::array_units)) return Texture::array_units;
+            return Texture::array_units - MaterialSlotCount;
+        }
+
+        // Every texture the materials reference, once per name, in first-use order.
+        // Key of a texture in DataTex::textures. One file referenced from slots of
+        // different kinds is decoded and stored once per kind; the NUL cannot occur
+        // in a file name.
+        std::string textureKey(const std::string& texname, TextureKind kind) {
+            std::string key = texname;
+            key += '\0';
+            key += static_cast<char>('0' + static_cast<int>(kind));
+            return key;
         }
-    }
 
-    void Texture::BindMaterialTextures(const texture_names& mat, GLuint programId, DataTex& data) {
-        auto TryBind = [&programId, &data](const std::string& texName, const std::string& uniformName, int unit) {
-            if (!texName.empty() && data.textures.contains(texName)) {
-                glActiveTexture(GL_TEXTURE0 + unit);
-                glBindTexture(GL_TEXTURE_2D, data.textures.at(texName));
-                glUniform1i(glGetUniformLocation(programId, uniformName.c_str()), unit);
+        std::vector<DecodeJob> collectTextures(const std::vector<Material>& materials) {
+            std::vector<DecodeJob> jobs;
+            std::unordered_set<std::string> seen;
+            for (const auto& mat : materials) {
+                for (const SlotInfo& slot : kSlots) {
+                    const std::string& texname = mat.texNames.*slot.name;
+                    if (texname.empty() || !seen.insert(textureKey(texname, slot.kind)).second) continue;
+                    jobs.push_back({texname, slot.kind});
+                }
+            }
+            return jobs;
+        }
+
+        // Normal maps go to BC5 (x and y only) whatever their source channels;
+        // otherwise one or two channels go to BC4/BC5, RGB to BC1 and RGBA to BC3.
+        BlockFormat blockFormat(TextureKind kind, int channels) {
+            if (kind == TextureKind::Normal) return BlockFormat::BC5;
+            if (channels == 1) return BlockFormat::BC4;
+            if (channels == 2) return BlockFormat::BC5;
+            return channels == 3 ? BlockFormat::BC1 : BlockFormat::BC3;
+        }
+
+        // Bump maps that hold heights rather than normals: one or two channels,
+        // or gray stored as RGB(A).
+        bool isHeightMap(const unsigned char* pixels, int width, int height, int channels) {
+            if (channels < 3) return true;
+            const size_t count = static_cast<size_t>(width) * height;
+            for (size_t i = 0; i < count; i++) {
+                const unsigned char* p = pixels + i * channels;
+                if (p[0] != p[1] || p[0] != p[2]) return false;
+            }
+            return true;
+        }
+
+        // Tangent-space normals (RGB, +y along the source v) from the first
+        // channel of a height map, by Sobel gradients that wrap like GL_REPEAT.
+        std::shared_ptr<unsigned char> heightToNormal(const unsigned char* pixels, int width, int height,
+                                                      int channels) {
+            constexpr float kBumpScale = 4.0f; // tilt per unit of height change across a texel
+            auto h = [&](int x, int y) {
+                x = (x + width) % width;
+                y = (y + height) % height;
+                return pixels[(static_cast<size_t>(y) * width + x) * channels] / 255.0f;
+            };
+            std::shared_ptr<unsigned char> normals(new unsigned char[static_cast<size_t>(width) * height * 3],
+                                                   std::default_delete<unsigned char[]>());
+            unsigned char* out = normals.get();
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    float du = (h(x + 1, y - 1) + 2.0f * h(x + 1, y) + h(x + 1, y + 1))
+                               - (h(x - 1, y - 1) + 2.0f * h(x - 1, y) + h(x - 1, y + 1));
+                    // Rows run down the image, against v.
+                    float dv = (h(x - 1, y - 1) + 2.0f * h(x, y - 1) + h(x + 1, y - 1))
+                               - (h(x - 1, y + 1) + 2.0f * h(x, y + 1) + h(x + 1, y + 1));
+                    glm::vec3 n = glm::normalize(glm::vec3(-du, -dv, 8.0f / kBumpScale));
+                    for (int c = 0; c < 3; c++) {
+                        *out++ = static_cast<unsigned char>(std::lround((n[c] * 0.5f + 0.5f) * 255.0f));
+                    }
+                }
+            }
+            return normals;
+        }
+
+        // Normal-kind pixels that hold heights, converted to normals; anything
+        // else is returned as is.
+        std::shared_ptr<unsigned char> asNormalMap(std::shared_ptr<unsigned char> pixels, TextureKind kind, int width,
+                                                   int height, int& channels) {
+            if (kind != TextureKind::Normal || !isHeightMap(pixels.get(), width, height, channels)) return pixels;
+            pixels = heightToNormal(pixels.get(), width, height, channels);
+            channels = 3;
+            return pixels;
+        }
+
+        GLenum pixelFormat(int channels) {
+            static constexpr GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+            return channels >= 1 && channels <= 4 ? formats[channels - 1] : GL_RGB;
+        }
+
+        GLenum sizedFormat(int channels) {
+            static constexpr GLenum formats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+            return channels >= 1 && channels <= 4 ? formats[channels - 1] : GL_RGB8;
+        }
+
+        GLenum compressedFormat(BlockFormat format) {
+            switch (format) {
+                case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+                case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+                case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+                default: return GL_COMPRESSED_RG_RGTC2;
+            }
+        }
+
+        // Image decoding and mip generation only, so tasks never wait on each other
+        // or on the model loader's pool.
+        ThreadPool& decodePool() {
+            static ThreadPool instance;
+            return instance;
+        }
+
+        // Decodes the jobs on the decode pool, with the calling thread taking jobs
+        // too, and hands every image to consume on the calling thread as it finishes.
+        void decodeAll(std::vector<DecodeJob> jobs, const std::string& filename, bool compress,
+                       const std::function<void(TextureImage&)>& consume) {
+            if (jobs.empty()) return;
+
+            // Shared with the pool tasks, which may start after this returns.
+            struct State {
+                std::vector<DecodeJob> jobs;
+                std::string filename;
+                bool compress = false;
+                std::atomic<size_t> next{0};
+                std::mutex mutex;
+                std::condition_variable done;
+                std::deque<TextureImage> decoded;
+                size_t finished = 0;
+
+                // Decodes one job; false once all have been taken.
+                bool decodeNext() {
+                    size_t i = next.fetch_add(1);
+                    if (i >= jobs.size()) return false;
+                    TextureImage image;
+                    const DecodeJob& job = jobs[i];
+                    bool ok = compress ? Texture::DecodeCompressed(filename, job.texname, image, job.kind)
+                                       : Texture::DecodeTexture(filename, job.texname, image, job.kind);
+                    {
+                        std::lock_guard lock(mutex);
+                        if (ok) decoded.push_back(std::move(image));
+                        finished++;
+                    }
+                    done.notify_one();
+                    return true;
+                }
+            };
+            auto state = std::make_shared<State>();
+            state->jobs = std::move(jobs);
+            state->filename = filename;
+            state->compress = compress;
+
+            const size_t count = state->jobs.size();
+            size_t helpers = std::min(decodePool().size(), count - 1);
+            for (size_t i = 0; i < helpers; i++) {
+                decodePool().submit([state] {
+                    while (state->decodeNext()) {}
+                });
             }
-        };
 
-        TryBind(mat.ambient_texname, "u_ambientTex", 0);
-        TryBind(mat.diffuse_texname, "u_diffuseTex", 1);
-        TryBind(mat.specular_texname, "u_specularTex", 2);
-        TryBind(mat.specular_highlight_texname, "u_specularHighTex", 3);
-        TryBind(mat.bump_texname, "u_bumpTex", 4);
-        TryBind(mat.reflection_texname, "u_reflectionTex", 5);
-        TryBind(mat.alpha_texname, "u_alphaTex", 6);
+            for (;;) {
+                std::unique_lock lock(state->mutex);
+                while (!state->decoded.empty()) {
+                    TextureImage image = std::move(state->decoded.front());
+                    state->decoded.pop_front();
+                    lock.unlock();
+                    consume(image);
+                    lock.lock();
+                }
+                if (state->finished == count) return;
+                if (state->next.load() < count) {
+                    lock.unlock();
+                    state->decodeNext();
+                    continue;
+                }
+                state->done.wait(lock, [&] { return !state->decoded.empty() || state->finished == count; });
+            }
+        }
     }
 
-    void Texture::LoadTexture(std::string& filename, const std::string& texname, DataTex& data) {
-        FixPath(filename);
-        std::filesystem::path texPath = texname;
-        if (texPath.empty() || data.textures.contains(texPath.string())) return;
-        data.textures[texname] = LoadTexture(filename, texname);
+    void Texture::LoadMaterials(std::string& filename, DataTex& data) {
+        std::vector<DecodeJob> jobs;
+        for (DecodeJob& job : collectTextures(data.materials)) {
+            if (!data.textures.contains(textureKey(job.texname, job.kind))) jobs.push_back(std::move(job));
+        }
+        std::vector<TextureImage> images;
+        decodeAll(std::move(jobs), filename, false, [&](TextureImage& image) {
+            images.push_back(std::move(image));
+        });
+        PlaceInArrays(images, data);
+        for (TextureImage& image : images) {
+            UploadLayer(data.textureArrays[image.placement.array], std::move(image));
+        }
+    }
+
+    TextureFiltering Texture::filtering;
+
+    void Texture::DecodeMaterials(const std::vector<Material>& materials, std::string filename,
+                                  std::vector<TextureImage>& images, bool compress) {
+        compress = compress && SupportsCompression();
+        decodeAll(collectTextures(materials), filename, compress, [&](TextureImage& image) {
+            images.push_back(std::move(image));
+        });
     }
 
-    GLuint Texture::LoadTexture(std::string& filename, const std::string& texname) {
+    bool Texture::ResolvePath(std::string filename, const std::string& texname, std::filesystem::path& texPath) {
         FixPath(filename);
-        std::filesystem::path texPath = texname;
+        texPath = texname;
         std::string baseDir = GetBaseDir(filename);
         if (baseDir.empty()) baseDir = ".";
 
@@ -58,57 +268,326 @@ namespace gl {
             texPath = newPath;
             if (!std::filesystem::exists(texPath)) {
                 std::cerr << "Texture not found: " << texPath << "\n";
-                exit(1);
+                return false;
             }
         }
+        return true;
+    }
+
+    bool Texture::DecodeTexture(std::string filename, const std::string& texname, TextureImage& image,
+                                TextureKind kind, bool mipmaps) {
+        std::filesystem::path texPath;
+        if (!ResolvePath(filename, texname, texPath)) return false;
+
+        MappedFile source(texPath.string());
+        unsigned char* pixels = nullptr;
+        if (source.valid()) {
+            pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &image.width, &image.height,
+                                           &image.channels, STBI_default);
+        }
+        if (!pixels) {
+            std::cerr << "Failed to load texture: " << texPath << "\n";
+            return false;
+        }
+        image.name = texname;
+        image.contentHash = TextureCache::contentHash(source.data(), source.size());
+        image.kind = kind;
+        image.pixels = asNormalMap(std::shared_ptr<unsigned char>(pixels, stbi_image_free), kind, image.width,
+                                   image.height, image.channels);
+        if (mipmaps) {
+            image.mips = Mipmap::generate(image.pixels.get(), image.width, image.height, image.channels,
+                                          kind == TextureKind::Color);
+        }
+        return true;
+    }
+
+    bool Texture::DecodeCompressed(std::string filename, const std::string& texname, TextureImage& image,
+                                   TextureKind kind) {
+        std::filesystem::path texPath;
+        if (!ResolvePath(filename, texname, texPath)) return false;
+        MappedFile source(texPath.string());
+        if (!source.valid()) {
+            std::cerr << "Failed to load texture: " << texPath << "\n";
+            return false;
+        }
+        image.name = texname;
+        image.kind = kind;
+        image.contentHash = TextureCache::contentHash(source.data(), source.size());
+        std::string cachePath = TextureCache::cachePath(texPath.string(), image.contentHash, kind);
+        if (TextureCache::load(cachePath, image)) return true;
 
         int width, height, channels;
-        unsigned char* image = stbi_load(texPath.string().c_str(), &width, &height, &channels, STBI_default);
-        if (!image) {
+        unsigned char* pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &width, &height,
+                                                      &channels, STBI_default);
+        if (!pixels) {
             std::cerr << "Failed to load texture: " << texPath << "\n";
-            exit(1);
+            return false;
+        }
+        std::shared_ptr<unsigned char> texels =
+                asNormalMap(std::shared_ptr<unsigned char>(pixels, stbi_image_free), kind, width, height, channels);
+        BlockFormat format = blockFormat(kind, channels);
+        std::vector<MipLevel> mips = Mipmap::generate(texels.get(), width, height, channels, kind == TextureKind::Color);
+        image.compressedLevels.push_back(
+                {width, height, BlockCompress::encode(format, texels.get(), width, height, channels)});
+        texels.reset();
+        for (const MipLevel& mip : mips) {
+            image.compressedLevels.push_back(
+                    {mip.width, mip.height, BlockCompress::encode(format, mip.pixels.data(), mip.width, mip.height, channels)});
         }
+        image.width = width;
+        image.height = height;
+        image.channels = BlockCompress::channelCount(format);
+        image.compressed = format;
+        TextureCache::store(cachePath, image);
+        return true;
+    }
+
+    bool Texture::SupportsCompression() {
+        return GLEW_EXT_texture_compression_s3tc && (GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc);
+    }
 
+    GLuint Texture::UploadTexture(const TextureImage& image) {
         GLuint textureID;
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-        GLenum format = GL_RGB;
-        if (channels == 1) format = GL_RED;
-        else if (channels == 2) format = GL_RG;
-        else if (channels == 4) format = GL_RGBA;
+        if (image.compressed != BlockFormat::None) {
+            GLenum internalFormat = compressedFormat(image.compressed);
+            for (size_t i = 0; i < image.compressedLevels.size(); i++) {
+                const gl::MipLevel& level = image.compressedLevels[i];
+                glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), internalFormat, level.width, level.height,
+                                       0, static_cast<GLsizei>(level.pixels.size()),
+                                       UploadRing::stage(level.pixels.data(), level.pixels.size()));
+            }
+            UploadRing::submit();
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.compressedLevels.size()) - 1);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            ApplyFiltering(textureID);
+            return textureID;
+        }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        stbi_image_free(image);
+        GLenum format = pixelFormat(image.channels);
 
+        // Rows of RGB and small levels are not 4-byte aligned.
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t size = static_cast<size_t>(image.width) * image.height * image.channels;
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE,
+                     UploadRing::stage(image.pixels.get(), size));
+        for (size_t i = 0; i < image.mips.size(); i++) {
+            const gl::MipLevel& level = image.mips[i];
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i + 1), format, level.width, level.height, 0, format,
+                         GL_UNSIGNED_BYTE, UploadRing::stage(level.pixels.data(), level.pixels.size()));
+        }
+        UploadRing::submit();
+        if (image.mips.empty()) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        ApplyFiltering(textureID);
         return textureID;
     }
 
-    GLuint Texture::LoadTextureEmbedded(int bufferSize, void* data) {
-        int width, height, channels;
-        void* image = stbi_load_from_memory((const stbi_uc*)data, bufferSize, &width, &height, &channels, 0);
-        GLuint textureID;
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    void Texture::PlaceInArrays(std::vector<TextureImage>& images, DataTex& data) {
+        constexpr int kMaxLayers = 256; // the least GL_MAX_ARRAY_TEXTURE_LAYERS can be
 
-        GLenum format = GL_RGB;
-        if (channels == 1) format = GL_RED;
-        else if (channels == 2) format = GL_RG;
-        else if (channels == 4) format = GL_RGBA;
+        // Arrays from earlier calls already have their storage, so only new ones take layers.
+        const size_t firstNew = data.textureArrays.size();
+        // First image placed per (content, kind); kind changes how the texels are stored.
+        std::unordered_map<uint64_t, const TextureImage*> placed;
+        auto duplicate = [](const TextureImage& image) { return image.placement.array < 0; };
+        for (TextureImage& image : images) {
+            uint64_t key = image.contentHash ^ static_cast<uint64_t>(image.kind);
+            auto [it, added] = placed.try_emplace(key, &image);
+            const TextureImage* original = it->second;
+            if (!added && image.contentHash && original->width == image.width && original->height == image.height &&
+                original->channels == image.channels && original->compressed == image.compressed) {
+                data.textures[textureKey(image.name, image.kind)] = original->placement;
+                image.placement = {};
+                continue;
+            }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        stbi_image_free(image);
-        return textureID;
+            TextureArray shape;
+            shape.width = image.width;
+            shape.height = image.height;
+            shape.channels = image.channels;
+            shape.compressed = image.compressed;
+            shape.levels = static_cast<int>(image.compressed != BlockFormat::None ? image.compressedLevels.size()
+                                                                                 : 1 + image.mips.size());
+            size_t a = firstNew;
+            for (; a < data.textureArrays.size(); a++) {
+                const TextureArray& t = data.textureArrays[a];
+                if (t.width == shape.width && t.height == shape.height && t.channels == shape.channels &&
+                    t.compressed == shape.compressed && t.levels == shape.levels && t.layers < kMaxLayers) break;
+            }
+            if (a == data.textureArrays.size()) data.textureArrays.push_back(shape);
+            image.placement = {static_cast<int32_t>(a), data.textureArrays[a].layers++};
+            data.textures[textureKey(image.name, image.kind)] = image.placement;
+        }
+        images.erase(std::remove_if(images.begin(), images.end(), duplicate), images.end());
+
+        for (Material& m : data.materials) {
+            for (int i = 0; i < MaterialSlotCount; i++) {
+                auto it = data.textures.find(textureKey(m.texNames.*kSlots[i].name, kSlots[i].kind));
+                m.layers[i] = it != data.textures.end() ? it->second : TextureLayer{};
+            }
+        }
+    }
+
+    GLuint Texture::AllocateArray(const TextureArray& array, int firstLevel) {
+        const bool compressed = array.compressed != BlockFormat::None;
+        const GLenum internalFormat = compressed ? compressedFormat(array.compressed) : sizedFormat(array.channels);
+        const int levels = array.levels - firstLevel;
+        const int width = std::max(1, array.width >> firstLevel);
+        const int height = std::max(1, array.height >> firstLevel);
+
+        GLuint id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+        if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, array.layers);
+        } else {
+            int w = width;
+            int h = height;
+            for (int level = 0; level < levels; level++) {
+                if (compressed) {
+                    auto size = static_cast<GLsizei>(BlockCompress::levelSize(array.compressed, w, h) * array.layers);
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w, h, array.layers, 0, size,
+                                           nullptr);
+                } else {
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, static_cast<GLint>(internalFormat), w, h, array.layers, 0,
+                                 pixelFormat(array.channels), GL_UNSIGNED_BYTE, nullptr);
+                }
+                w = std::max(1, w / 2);
+                h = std::max(1, h / 2);
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        ApplyFiltering(id, GL_TEXTURE_2D_ARRAY);
+        return id;
+    }
+
+    void Texture::UploadLevels(const TextureArray& array, GLuint id, int firstLevel, const TextureImage& image,
+                               int from, int to) {
+        const bool compressed = array.compressed != BlockFormat::None;
+        const GLenum format = pixelFormat(array.channels);
+        const GLint layer = image.placement.layer;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int level = from; level < to; level++) {
+            const GLint target = level - firstLevel;
+            if (compressed) {
+                const MipLevel& l = image.compressedLevels[level];
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, layer, l.width, l.height, 1,
+                                          compressedFormat(array.compressed), static_cast<GLsizei>(l.pixels.size()),
+                                          UploadRing::stage(l.pixels.data(), l.pixels.size()));
+            } else if (level == 0) {
+                size_t size = static_cast<size_t>(image.width) * image.height * image.channels;
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, layer, image.width, image.height, 1, format,
+                                GL_UNSIGNED_BYTE, UploadRing::stage(image.pixels.get(), size));
+            } else {
+                const MipLevel& l = image.mips[level - 1];
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, layer, l.width, l.height, 1, format,
+                                GL_UNSIGNED_BYTE, UploadRing::stage(l.pixels.data(), l.pixels.size()));
+            }
+        }
+        UploadRing::submit();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    void Texture::UploadLayer(TextureArray& array, TextureImage&& image) {
+        if (!array.id) {
+            if (TextureStreamer::settings.enabled) {
+                array.residentLevel = TextureStreamer::initialLevel(array);
+                array.sources.resize(array.layers);
+            }
+            array.id = AllocateArray(array, array.residentLevel);
+        }
+        UploadLevels(array, array.id, array.residentLevel, image, array.residentLevel, array.levels);
+        // Streamed arrays keep the decoded image to upload finer levels later.
+        if (!array.sources.empty()) {
+            size_t layer = static_cast<size_t>(image.placement.layer);
+            array.sources[layer] = std::make_shared<const TextureImage>(std::move(image));
+        }
+    }
+
+    void Texture::ApplyFiltering(GLuint textureID, GLenum target) {
+        glBindTexture(target, textureID);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filtering.mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        float maxAnisotropy = MaxAnisotropy();
+        if (maxAnisotropy > 1.0f) {
+            glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::clamp(filtering.anisotropy, 1.0f, maxAnisotropy));
+        }
+        glBindTexture(target, 0);
+    }
+
+    float Texture::MaxAnisotropy() {
+        static float maxAnisotropy = 0.0f;
+        if (maxAnisotropy == 0.0f) {
+            maxAnisotropy = 1.0f;
+            if (GLEW_EXT_texture_filter_anisotropic || GLEW_ARB_texture_filter_anisotropic) {
+                glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+            }
+        }
+        return maxAnisotropy;
+    }
+
+    void Texture::SetTextureArrayUnits(GLuint programId) {
+        GLint units[array_units];
+        for (int unit = 0; unit < array_units; unit++) units[unit] = unit;
+        glUseProgram(programId);
+        glUniform1iv(Shader::uniform(programId, "uTextureArrays"), array_units, units);
+    }
+
+    void Texture::BindTextureArrays(const DataTex& data) {
+        const int shared = sharedUnits(data);
+        for (int unit = 0; unit < shared && static_cast<size_t>(unit) < data.textureArrays.size(); unit++) {
+            RenderState::bindTexture(unit, GL_TEXTURE_2D_ARRAY, data.textureArrays[unit].id);
+        }
+    }
+
+    void Texture::MaterialTextureSlots(const Material& mat, const DataTex& data, glm::ivec4 slots[MaterialSlotCount]) {
+        const int shared = sharedUnits(data);
+        for (int i = 0; i < MaterialSlotCount; i++) {
+            const TextureLayer& t = mat.layers[i];
+            int unit = t.array < 0 ? 0 : (t.array < shared ? t.array : shared + i);
+            slots[i] = glm::ivec4(unit, t.array >= 0 ? t.layer : -1, 0, 0);
+        }
+    }
+
+    void Texture::BindMaterialTextures(const Material& mat, const DataTex& data) {
+        const int shared = sharedUnits(data);
+        for (int i = 0; i < MaterialSlotCount; i++) {
+            const TextureLayer& t = mat.layers[i];
+            if (t.array < shared) continue;
+            RenderState::bindTexture(shared + i, GL_TEXTURE_2D_ARRAY, data.textureArrays[t.array].id);
+        }
+    }
+
+    GLuint Texture::LoadTexture(std::string& filename, const std::string& texname, TextureKind kind) {
+        FixPath(filename);
+        TextureImage image;
+        if (!DecodeTexture(filename, texname, image, kind)) {
+            exit(1);
+        }
+        return UploadTexture(image);
+    }
+
+    GLuint Texture::LoadTextureEmbedded(int bufferSize, void* data) {
+        TextureImage image;
+        unsigned char* pixels = stbi_load_from_memory((const stbi_uc*)data, bufferSize, &image.width, &image.height,
+                                                      &image.channels, 0);
+        if (pixels) {
+            image.pixels.reset(pixels, stbi_image_free);
+            image.mips = Mipmap::generate(pixels, image.width, image.height, image.channels, true);
+        }
+        return UploadTexture(image);
     }
 
     std::string Texture::GetBaseDir(std::string_view filepath) {
@@ -116,47 +595,80 @@ namespace gl {
         return (pos != std::string::npos) ? std::string(filepath.substr(0, pos)) : "";
     }
 
-    GLint Texture::LoadCubemap(const std::vector<std::string>& faces) {
+    bool Texture::DecodeCubemap(const std::vector<std::string>& faces, std::vector<TextureImage>& images,
+                                bool compress) {
+        std::vector<DecodeJob> jobs;
+        for (const std::string& face : faces) jobs.push_back({face, TextureKind::Color});
+        std::vector<TextureImage> decoded;
+        decodeAll(std::move(jobs), "", compress && SupportsCompression(), [&](TextureImage& image) {
+            decoded.push_back(std::move(image));
+        });
+
+        // Back into face order; faces finish in any order.
+        images.clear();
+        for (const std::string& face : faces) {
+            auto it = std::find_if(decoded.begin(), decoded.end(), [&](const TextureImage& i) { return i.name == face; });
+            if (it == decoded.end()) {
+                std::cerr << "Cubemap load failed at: " << face << "\n";
+                images.clear();
+                return false;
+            }
+            images.push_back(std::move(*it));
+        }
+        return true;
+    }
+
+    GLuint Texture::UploadCubemap(const std::vector<TextureImage>& faces) {
         GLuint textureID;
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-        int width, height, channels;
+        size_t levels = 1;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
         for (GLuint i = 0; i < faces.size(); i++) {
-            const std::string& path = faces[i];
-            unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
-            if (data) {
-                GLenum format = GL_RGB;
-                if (channels == 1)      format = GL_RED;
-                else if (channels == 2) format = GL_RG;
-                else if (channels == 4) format = GL_RGBA;
-
-                glTexImage2D(
-                    GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                    0,                // mip level
-                    format,           // internal format
-                    width, height,
-                    0,                // border
-                    format,           // source format
-                    GL_UNSIGNED_BYTE, // source type
-                    data
-                );
-                stbi_image_free(data);
-            } else {
-                std::cerr << "Cubemap load failed at: " << path << "\n";
-                stbi_image_free(data);
+            const TextureImage& face = faces[i];
+            const GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+            if (face.compressed != BlockFormat::None) {
+                GLenum internalFormat = compressedFormat(face.compressed);
+                for (size_t level = 0; level < face.compressedLevels.size(); level++) {
+                    const MipLevel& l = face.compressedLevels[level];
+                    glCompressedTexImage2D(target, static_cast<GLint>(level), internalFormat, l.width, l.height, 0,
+                                           static_cast<GLsizei>(l.pixels.size()),
+                                           UploadRing::stage(l.pixels.data(), l.pixels.size()));
+                }
+                levels = face.compressedLevels.size();
+                continue;
+            }
+
+            GLenum format = pixelFormat(face.channels);
+            size_t size = static_cast<size_t>(face.width) * face.height * face.channels;
+            glTexImage2D(target, 0, format, face.width, face.height, 0, format, GL_UNSIGNED_BYTE,
+                         UploadRing::stage(face.pixels.get(), size));
+            for (size_t level = 0; level < face.mips.size(); level++) {
+                const MipLevel& l = face.mips[level];
+                glTexImage2D(target, static_cast<GLint>(level + 1), format, l.width, l.height, 0, format,
+                             GL_UNSIGNED_BYTE, UploadRing::stage(l.pixels.data(), l.pixels.size()));
             }
+            levels = 1 + face.mips.size();
         }
+        UploadRing::submit();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
         // set filtering and wrapping
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels) - 1);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R,     GL_CLAMP_TO_EDGE);
 
         glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-        return static_cast<GLint>(textureID);
+        ApplyFiltering(textureID, GL_TEXTURE_CUBE_MAP);
+        return textureID;
+    }
+
+    GLint Texture::LoadCubemap(const std::vector<std::string>& faces) {
+        std::vector<TextureImage> images;
+        if (!DecodeCubemap(faces, images)) return 0;
+        return static_cast<GLint>(UploadCubemap(images));
     }
 
 
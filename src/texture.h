@@ -1,11 +1,20 @@
 #pragma once
 
+#include <cfloat>
+#include <climits>
 #include <glm/glm.hpp>
+#include <filesystem>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include "block_compress.h"
+#include "bvh.h"
 #include "debug.h"
+#include "mipmap.h"
+#include "occlusion.h"
 #include "tiny_obj_loader.h"
+#include "vertex_format.h"
 
 struct texture_names {
     std::string ambient_texname;             // map_Ka. For ambient or ambient occlusion.
@@ -17,50 +26,229 @@ struct texture_names {
     std::string reflection_texname;
 };
 
+// Material texture slots, in the order of Material::layers and the fragment
+// shader's uMaterialTextures.
+enum MaterialSlot {
+    AmbientSlot,
+    DiffuseSlot,
+    SpecularSlot,
+    SpecularHighlightSlot,
+    BumpSlot,
+    ReflectionSlot,
+    AlphaSlot,
+    MaterialSlotCount
+};
+
+// Where a material texture lives: one layer of its model's texture arrays.
+struct TextureLayer {
+    int32_t array = -1; // index into DataTex::textureArrays, -1 for an empty slot
+    int32_t layer = 0;
+};
+
+struct Material {
+    glm::vec3 ambient{0.0f};
+    glm::vec3 diffuse{0.0f};
+    glm::vec3 specular{0.0f};
+    glm::vec3 transmittance{0.0f};
+    glm::vec3 emission{0.0f};
+    float shininess = 0.0f;
+    float ior = 0.0f;
+    float dissolve = 0.0f;
+    int illum = 0;
+    texture_names texNames;
+    TextureLayer layers[MaterialSlotCount]; // resolved from texNames by Texture::PlaceInArrays
+};
+
+// Contiguous range of a DrawObject's index buffer drawn with one material.
+struct SubMesh {
+    size_t firstIndex = 0;
+    size_t numIndices = 0;
+    size_t material_id = 0; // index into DataTex::materials
+    float uvDensity = 0.0f; // texture-space units per object-space unit, for streaming
+};
+
+// A coarser version of a DrawObject: its own sub-mesh ranges in the object's
+// index buffer, over the same vertices.
+struct MeshLod {
+    std::vector<SubMesh> subMeshes;
+    float error = 0.0f; // max object-space deviation from the full-detail mesh
+};
+
 struct DrawObject {
     GLuint vao = 0;
-    GLuint vbo = 0; // vertex buffer id
+    GLuint vbo = 0; // vertex buffer id, shared by all objects in the SceneBuffer
+    GLuint ebo = 0; // index buffer id, 0 for non-indexed geometry
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLint baseVertex = 0;   // first vertex of this object in vbo
+    size_t indexOffset = 0; // byte offset of this object's indices in ebo
     size_t numTriangles = 0;
-    size_t material_id = -1;
 
     glm::vec3 bmin; // Boundary Min
     glm::vec3 bmax; // Boundary Max
+    glm::vec3 center{0.0f}; // bounding sphere, in the same space as bmin/bmax
+    float radius = 0.0f;
 
-    // Texture related
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-    glm::vec3 transmittance;
-    glm::vec3 emission;
-    float shininess;
-    float ior;
-    float dissolve;
-    int illum;
-    int material_size;
-    texture_names texNames;
+    std::vector<SubMesh> subMeshes; // one per material, in index-buffer order
+    std::vector<MeshLod> lods;      // coarser levels, by increasing error
+
+    std::shared_ptr<const gl::MeshBvh> bvh; // full-detail triangles, for ray queries
+};
+
+// What a texture's texels hold, which decides how it is filtered and compressed.
+enum class TextureKind {
+    Color,  // sRGB color, mipmapped in linear light
+    Data,   // linear values: exponents, coverage, heights
+    Normal, // tangent-space normal map; compressed to its x and y only. Gray
+            // (height) bump maps are converted to normals when decoded.
+};
+
+// Decoded pixels of one material texture, produced off the GL thread.
+struct TextureImage {
+    std::string name; // texture name as referenced by the material
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::shared_ptr<unsigned char> pixels;
+    TextureKind kind = TextureKind::Color;
+    uint64_t contentHash = 0; // of the source file; identical files share one layer
+    std::vector<gl::MipLevel> mips;  // levels 1 and up; empty lets the driver build them
+    // Block-compressed levels from level 0 up, uploaded instead of pixels and mips.
+    gl::BlockFormat compressed = gl::BlockFormat::None;
+    std::vector<gl::MipLevel> compressedLevels;
+    TextureLayer placement; // set by Texture::PlaceInArrays
 };
 
 namespace gl {
 
+    // A GL_TEXTURE_2D_ARRAY of textures sharing size, format and mip count.
+    struct TextureArray {
+        GLuint id = 0; // created by the first Texture::UploadLayer
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        BlockFormat compressed = BlockFormat::None;
+        int levels = 1;
+        int layers = 0;
+
+        // Streaming (see TextureStreamer): id holds levels residentLevel and up,
+        // and sources keeps each layer's image for uploading finer levels again.
+        // sources is empty for arrays uploaded whole.
+        int residentLevel = 0;
+        int wantedLevel = INT_MAX; // finest level a draw asked for since the last update
+        uint64_t lastUsed = 0;     // streamer frame of that draw
+        std::vector<std::shared_ptr<const TextureImage>> sources;
+    };
+
     class DataTex {
 
     public:
 
-        std::unordered_map<std::string, GLuint> textures;
+        // The materials' textures, grouped into arrays, and each one's layer by
+        // name and kind.
+        std::vector<TextureArray> textureArrays;
+        std::unordered_map<std::string, TextureLayer> textures;
+        std::vector<Material> materials;
+        // Material block records, one per material materialStride bytes apart
+        // (see UniformBuffers::uploadMaterials).
+        GLuint materialBuffer = 0;
+        size_t materialStride = 0;
         std::vector<DrawObject> m_draw_objects;
+
+        // Layout of every object's vertices; quantization decodes Packed16 positions.
+        gl::VertexFormat format = gl::VertexFormat::Float32;
+        gl::PositionQuantization quantization;
+
+        // Bounding spheres of m_draw_objects in the same order, for culling, and
+        // the bounds of all objects together.
+        gl::SphereBounds bounds;
+        // Hierarchy over the boxes of m_draw_objects, built with the model.
+        gl::Bvh bvh;
+        gl::OcclusionState occlusion;
+        glm::vec3 bmin{FLT_MAX};
+        glm::vec3 bmax{-FLT_MAX};
+
+        void addObject(const DrawObject& o) {
+            m_draw_objects.push_back(o);
+            bounds.push(o.center, o.radius);
+            if (o.numTriangles > 0) {
+                bmin = glm::min(bmin, o.bmin);
+                bmax = glm::max(bmax, o.bmax);
+            }
+        }
+    };
+
+    // Sampling of every mipmapped 2D texture.
+    struct TextureFiltering {
+        bool mipmaps = true;     // trilinear filtering, otherwise bilinear from level 0
+        float anisotropy = 8.0f; // clamped to what the driver supports; 1 turns it off
     };
 
     class Texture {
     public:
-        static void LoadMaterials(const std::vector<tinyobj::material_t>& materials, std::string& filename, DataTex& data);
-        static void BindMaterialTextures(const texture_names& mat, GLuint programId, DataTex& data);
-        static void LoadTexture(std::string& filename, const std::string& texname, DataTex& data);
+        // Texture units the fragment shader's uTextureArrays occupy.
+        static constexpr int array_units = 16;
+
+        static TextureFiltering filtering;
+
+        // Decodes the textures of data's materials on worker threads, then places
+        // them in texture arrays and uploads them on the calling (GL) thread.
+        static void LoadMaterials(std::string& filename, DataTex& data);
+        // Decodes every texture the materials reference, once per name, spread over
+        // worker threads with the caller taking a share. With compress the images
+        // are block-compressed through the texture cache when the driver supports
+        // it. Touches no GL state, so it can run on a worker thread.
+        static void DecodeMaterials(const std::vector<Material>& materials, std::string filename,
+                                    std::vector<TextureImage>& images, bool compress = false);
+        // Loads the image and, unless mipmaps is false, builds its mip chain.
+        static bool DecodeTexture(std::string filename, const std::string& texname, TextureImage& image,
+                                  TextureKind kind = TextureKind::Color, bool mipmaps = true);
+        // Like DecodeTexture, but returns the block-compressed mip chain, read from
+        // the texture cache or encoded and stored there.
+        static bool DecodeCompressed(std::string filename, const std::string& texname, TextureImage& image,
+                                     TextureKind kind);
+        static bool SupportsCompression();
+        static GLuint UploadTexture(const TextureImage& image);
+        // Groups images by size, format and mip count into new arrays of data
+        // (at most 256 layers each), sets each image's placement and resolves the
+        // layers of data's materials. Images whose content matches an earlier one
+        // share its layer and are removed from images. Touches no GL state.
+        static void PlaceInArrays(std::vector<TextureImage>& images, DataTex& data);
+        // Copies image into its layer, creating the array's storage first if needed.
+        // With streaming on, storage starts at a coarse level and keeps the image.
+        static void UploadLayer(TextureArray& array, TextureImage&& image);
+        // Storage for levels firstLevel and up of array, with its sampling set.
+        static GLuint AllocateArray(const TextureArray& array, int firstLevel);
+        // Uploads levels [from, to) of image to its layer of id, whose storage
+        // starts at firstLevel.
+        static void UploadLevels(const TextureArray& array, GLuint id, int firstLevel, const TextureImage& image,
+                                 int from, int to);
+        // Applies filtering to a texture of any 2D, 2D array or cube map target.
+        static void ApplyFiltering(GLuint textureID, GLenum target = GL_TEXTURE_2D);
+        static float MaxAnisotropy();
+        // Points the program's uTextureArrays at units 0 to array_units - 1, once after linking.
+        static void SetTextureArrayUnits(GLuint programId);
+        // Binds data's first array_units arrays, once per model and frame.
+        static void BindTextureArrays(const DataTex& data);
+        // The (unit, layer) each slot of mat samples, in x and y; the layer is -1
+        // for an empty slot. Fixed once data's arrays are placed.
+        static void MaterialTextureSlots(const Material& mat, const DataTex& data, glm::ivec4 slots[MaterialSlotCount]);
+        // Binds an array only when the model has more arrays than units and the
+        // one the material needs is not bound.
+        static void BindMaterialTextures(const Material& mat, const DataTex& data);
         static GLuint LoadTextureEmbedded(int bufferSize, void* data);
-        static GLuint LoadTexture(std::string& filename, const std::string& texname);
+        static GLuint LoadTexture(std::string& filename, const std::string& texname,
+                                  TextureKind kind = TextureKind::Color);
 
+        // Decodes the six faces of a cubemap (+X, -X, +Y, -Y, +Z, -Z) in parallel,
+        // mipmapped, and block-compressed through the texture cache with compress.
+        // Touches no GL state.
+        static bool DecodeCubemap(const std::vector<std::string>& faces, std::vector<TextureImage>& images,
+                                  bool compress = false);
+        static GLuint UploadCubemap(const std::vector<TextureImage>& faces);
         static GLint LoadCubemap(const std::vector<std::string> & faces);
 
     private:
+        static bool ResolvePath(std::string filename, const std::string& texname, std::filesystem::path& path);
         static std::string GetBaseDir(std::string_view filepath);
         static void FixPath(std::string &path);
     };
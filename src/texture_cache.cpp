@@ -0,0 +1,202 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <type_traits>
+
+#include "mapped_file.h"
+#include "texture.h"
+
+namespace gl {
+
+    namespace {
+        constexpr uint32_t fourCC(char a, char b, char c, char d) {
+            return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 |
+                   static_cast<uint32_t>(d) << 24;
+        }
+
+        constexpr uint32_t kMagic = fourCC('D', 'D', 'S', ' ');
+
+        struct DdsPixelFormat {
+            uint32_t size;
+            uint32_t flags;
+            uint32_t fourCC;
+            uint32_t rgbBitCount;
+            uint32_t masks[4];
+        };
+
+        struct DdsHeader {
+            uint32_t size;
+            uint32_t flags;
+            uint32_t height;
+            uint32_t width;
+            uint32_t pitchOrLinearSize;
+            uint32_t depth;
+            uint32_t mipMapCount;
+            uint32_t reserved1[11];
+            DdsPixelFormat format;
+            uint32_t caps[4];
+            uint32_t reserved2;
+        };
+
+        static_assert(sizeof(DdsHeader) == 124);
+        static_assert(std::is_trivially_copyable_v<DdsHeader>);
+
+        constexpr uint32_t kFlagCaps = 0x1, kFlagHeight = 0x2, kFlagWidth = 0x4, kFlagPixelFormat = 0x1000;
+        constexpr uint32_t kFlagMipMapCount = 0x20000, kFlagLinearSize = 0x80000;
+        constexpr uint32_t kPixelFourCC = 0x4;
+        constexpr uint32_t kCapsComplex = 0x8, kCapsTexture = 0x1000, kCapsMipMap = 0x400000;
+
+        struct FormatCode {
+            BlockFormat format;
+            uint32_t fourCC;
+        };
+
+        constexpr FormatCode kFormats[] = {
+                {BlockFormat::BC1, fourCC('D', 'X', 'T', '1')},
+                {BlockFormat::BC3, fourCC('D', 'X', 'T', '5')},
+                {BlockFormat::BC4, fourCC('B', 'C', '4', 'U')},
+                {BlockFormat::BC5, fourCC('B', 'C', '5', 'U')},
+        };
+
+        constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+
+        uint64_t rotl(uint64_t v, int r) {
+            return (v << r) | (v >> (64 - r));
+        }
+
+        uint64_t avalanche(uint64_t h) {
+            h ^= h >> 33;
+            h *= kPrime2;
+            h ^= h >> 29;
+            h *= kPrime1;
+            return h ^ (h >> 32);
+        }
+
+        // 64-bit hash over four independent lanes of 8-byte words.
+        uint64_t hashBytes(const unsigned char* data, size_t size) {
+            uint64_t lanes[4] = {kPrime1, kPrime2, ~kPrime1, ~kPrime2};
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                for (int l = 0; l < 4; l++) {
+                    uint64_t word;
+                    std::memcpy(&word, data + i + 8 * l, sizeof(word));
+                    lanes[l] = rotl(lanes[l] + word * kPrime2, 31) * kPrime1;
+                }
+            }
+            uint64_t h = size * kPrime1;
+            for (int l = 0; l < 4; l++) {
+                h = rotl(h ^ avalanche(lanes[l]), 27) * kPrime1;
+            }
+            for (; i < size; i++) {
+                h = rotl(h ^ (data[i] * kPrime2), 11) * kPrime1;
+            }
+            return avalanche(h);
+        }
+    }
+
+    uint64_t TextureCache::contentHash(const unsigned char* bytes, size_t size) {
+        return hashBytes(bytes, size);
+    }
+
+    std::string TextureCache::cachePath(const std::string& sourcePath, uint64_t contentHash, TextureKind kind) {
+        uint64_t key = avalanche(contentHash ^ (static_cast<uint64_t>(kind) << 32 | encoder_version));
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.dds", static_cast<unsigned long long>(key));
+        return (std::filesystem::path(sourcePath).parent_path() / ".texcache" / name).string();
+    }
+
+    bool TextureCache::load(const std::string& path, TextureImage& image) {
+        MappedFile file(path);
+        if (!file.valid() || file.size() < sizeof(kMagic) + sizeof(DdsHeader)) return false;
+
+        uint32_t magic;
+        DdsHeader header;
+        std::memcpy(&magic, file.data(), sizeof(magic));
+        std::memcpy(&header, file.data() + sizeof(magic), sizeof(header));
+        if (magic != kMagic || header.size != sizeof(DdsHeader) || !(header.format.flags & kPixelFourCC)) {
+            return false;
+        }
+        const FormatCode* code = nullptr;
+        for (const FormatCode& f : kFormats) {
+            if (f.fourCC == header.format.fourCC) code = &f;
+        }
+        if (!code || header.width == 0 || header.height == 0) return false;
+
+        std::vector<MipLevel> levels;
+        size_t offset = sizeof(magic) + sizeof(header);
+        int w = static_cast<int>(header.width);
+        int h = static_cast<int>(header.height);
+        for (uint32_t i = 0; i < std::max(1u, header.mipMapCount); i++) {
+            size_t size = BlockCompress::levelSize(code->format, w, h);
+            if (offset + size > file.size()) {
+                std::cerr << "Truncated texture cache: " << path << "\n";
+                return false;
+            }
+            levels.push_back({w, h, std::vector<unsigned char>(file.data() + offset, file.data() + offset + size)});
+            offset += size;
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+
+        image.width = static_cast<int>(header.width);
+        image.height = static_cast<int>(header.height);
+        image.channels = BlockCompress::channelCount(code->format);
+        image.compressed = code->format;
+        image.compressedLevels = std::move(levels);
+        return true;
+    }
+
+    void TextureCache::store(const std::string& path, const TextureImage& image) {
+        const FormatCode* code = nullptr;
+        for (const FormatCode& f : kFormats) {
+            if (f.format == image.compressed) code = &f;
+        }
+        if (!code || image.compressedLevels.empty()) return;
+
+        DdsHeader header{};
+        header.size = sizeof(DdsHeader);
+        header.flags = kFlagCaps | kFlagHeight | kFlagWidth | kFlagPixelFormat | kFlagMipMapCount | kFlagLinearSize;
+        header.height = static_cast<uint32_t>(image.height);
+        header.width = static_cast<uint32_t>(image.width);
+        header.pitchOrLinearSize = static_cast<uint32_t>(image.compressedLevels[0].pixels.size());
+        header.mipMapCount = static_cast<uint32_t>(image.compressedLevels.size());
+        header.format.size = sizeof(DdsPixelFormat);
+        header.format.flags = kPixelFourCC;
+        header.format.fourCC = code->fourCC;
+        header.caps[0] = kCapsTexture | (header.mipMapCount > 1 ? kCapsComplex | kCapsMipMap : 0);
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+        // Write to a temporary and rename, so a concurrent reader never sees a partial file.
+        std::string tmp = path + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        bool written;
+        {
+            std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&kMagic), sizeof(kMagic));
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            for (const MipLevel& level : image.compressedLevels) {
+                file.write(reinterpret_cast<const char*>(level.pixels.data()),
+                           static_cast<std::streamsize>(level.pixels.size()));
+            }
+            written = static_cast<bool>(file);
+        }
+        if (!written) {
+            std::cerr << "Could not write texture cache: " << tmp << "\n";
+            std::filesystem::remove(tmp, ec);
+            return;
+        }
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) {
+            std::cerr << "Could not write texture cache: " << path << " (" << ec.message() << ")\n";
+            std::filesystem::remove(tmp, ec);
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct TextureImage;
+enum class TextureKind;
+
+namespace gl {
+
+// Block-compressed textures cached as DDS files in a ".texcache" directory next
+// to the source image. Files are named after a hash of the source bytes, the
+// texture kind and the encoder version, so an edited image never hits a stale
+// entry and identical images share one.
+class TextureCache {
+public:
+    // Bump whenever the encoder's output changes.
+    static constexpr uint32_t encoder_version = 3;
+
+    // 64-bit hash of an image file's bytes, used for cache names and to spot
+    // identical images under different names.
+    static uint64_t contentHash(const unsigned char* bytes, size_t size);
+    static std::string cachePath(const std::string& sourcePath, uint64_t contentHash, TextureKind kind);
+    // Fills the compressed levels, size and format of image from a cache file.
+    static bool load(const std::string& path, TextureImage& image);
+    static void store(const std::string& path, const TextureImage& image);
+};
+}
@@ -0,0 +1,144 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace gl {
+
+    namespace {
+        // Largest level a streamed array starts with, in texels per side.
+        constexpr int kStartSize = 64;
+
+        // Arrays whose layers are all uploaded and kept for streaming.
+        bool streamable(const TextureArray& array) {
+            return array.id && !array.sources.empty() &&
+                   std::all_of(array.sources.begin(), array.sources.end(), [](const auto& s) { return s != nullptr; });
+        }
+
+        size_t levelBytes(const TextureArray& array, int level) {
+            int w = std::max(1, array.width >> level);
+            int h = std::max(1, array.height >> level);
+            if (array.compressed != BlockFormat::None) return BlockCompress::levelSize(array.compressed, w, h);
+            // Drivers pad RGB8 to four bytes per texel.
+            int texelBytes = array.channels == 3 ? 4 : array.channels;
+            return static_cast<size_t>(w) * h * texelBytes;
+        }
+    }
+
+    TextureStreaming TextureStreamer::settings;
+    uint64_t TextureStreamer::frame = 1;
+
+    int TextureStreamer::initialLevel(const TextureArray& array) {
+        int level = 0;
+        while (level + 1 < array.levels && std::max(array.width, array.height) >> level > kStartSize) level++;
+        return level;
+    }
+
+    void TextureStreamer::request(TextureArray& array, int level) {
+        array.wantedLevel = std::min(array.wantedLevel, level);
+        array.lastUsed = frame;
+    }
+
+    size_t TextureStreamer::bytes(const TextureArray& array, int firstLevel) {
+        size_t total = 0;
+        for (int level = firstLevel; level < array.levels; level++) total += levelBytes(array, level);
+        return total * array.layers;
+    }
+
+    void TextureStreamer::update(std::vector<DataTex>& models, double budgetMs) {
+        const auto start = std::chrono::steady_clock::now();
+        const size_t budget = static_cast<size_t>(std::max(settings.budgetMB, 1)) << 20;
+
+        // Least recently drawn first.
+        std::vector<TextureArray*> arrays;
+        size_t resident = 0;
+        for (DataTex& model : models) {
+            for (TextureArray& array : model.textureArrays) {
+                if (!streamable(array)) continue;
+                arrays.push_back(&array);
+                resident += bytes(array, array.residentLevel);
+            }
+        }
+        std::stable_sort(arrays.begin(), arrays.end(),
+                         [](const TextureArray* a, const TextureArray* b) { return a->lastUsed < b->lastUsed; });
+
+        // Drops the top level of the least recently drawn array last drawn before
+        // frame usedBefore; false when there is none left to shrink.
+        auto evictOne = [&](uint64_t usedBefore) {
+            for (TextureArray* array : arrays) {
+                if (array->lastUsed >= usedBefore) break;
+                if (array->residentLevel + 1 >= array->levels) continue;
+                size_t before = bytes(*array, array->residentLevel);
+                resize(*array, array->residentLevel + 1);
+                resident -= before - bytes(*array, array->residentLevel);
+                return true;
+            }
+            return false;
+        };
+
+        // A lowered budget evicts from everything, arrays in view included.
+        while (resident > budget && evictOne(UINT64_MAX)) {}
+
+        // Raise the arrays drawn last frame that need finer levels, widest gap
+        // first, making room from arrays that were not drawn.
+        std::vector<TextureArray*> upgrades;
+        for (TextureArray* array : arrays) {
+            if (array->lastUsed == frame && array->wantedLevel < array->residentLevel) upgrades.push_back(array);
+        }
+        std::stable_sort(upgrades.begin(), upgrades.end(), [](const TextureArray* a, const TextureArray* b) {
+            return a->residentLevel - a->wantedLevel > b->residentLevel - b->wantedLevel;
+        });
+        for (TextureArray* array : upgrades) {
+            double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (elapsedMs > budgetMs) break;
+
+            const size_t current = bytes(*array, array->residentLevel);
+            int target = std::max(array->wantedLevel, 0);
+            while (resident - current + bytes(*array, target) > budget && evictOne(frame)) {}
+            // Settle for the finest level that fits.
+            while (target < array->residentLevel && resident - current + bytes(*array, target) > budget) target++;
+            if (target < array->residentLevel) {
+                resize(*array, target);
+                resident += bytes(*array, target) - current;
+            }
+        }
+
+        for (TextureArray* array : arrays) array->wantedLevel = INT_MAX;
+        frame++;
+    }
+
+    void TextureStreamer::resize(TextureArray& array, int level) {
+        GLuint id = Texture::AllocateArray(array, level);
+
+        // Levels both storages hold are copied on the GPU when possible; the rest
+        // come from the kept images.
+        int uploadTo = array.levels;
+        if (GLEW_VERSION_4_3 || GLEW_ARB_copy_image) {
+            uploadTo = std::max(level, array.residentLevel);
+            for (int l = uploadTo; l < array.levels; l++) {
+                glCopyImageSubData(array.id, GL_TEXTURE_2D_ARRAY, l - array.residentLevel, 0, 0, 0,
+                                   id, GL_TEXTURE_2D_ARRAY, l - level, 0, 0, 0,
+                                   std::max(1, array.width >> l), std::max(1, array.height >> l), array.layers);
+            }
+        }
+        for (const auto& source : array.sources) {
+            Texture::UploadLevels(array, id, level, *source, level, uploadTo);
+        }
+
+        glDeleteTextures(1, &array.id);
+        array.id = id;
+        array.residentLevel = level;
+    }
+
+    TextureStreamer::Stats TextureStreamer::stats(const std::vector<DataTex>& models) {
+        Stats stats;
+        for (const DataTex& model : models) {
+            for (const TextureArray& array : model.textureArrays) {
+                if (array.sources.empty() || !array.id) continue;
+                stats.residentBytes += bytes(array, array.residentLevel);
+                stats.fullBytes += bytes(array, 0);
+            }
+        }
+        return stats;
+    }
+}
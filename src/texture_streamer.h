@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "texture.h"
+
+namespace gl {
+
+struct TextureStreaming {
+    bool enabled = false; // applies to models loaded afterwards
+    int budgetMB = 1024;  // video memory for streamed arrays
+};
+
+// Mip streaming of texture arrays. A streamed array is uploaded from its
+// coarsest levels, and each frame the draws ask for the finest level their
+// on-screen texel density needs. update() then rebuilds arrays with more or
+// fewer levels, keeping everything within the budget by dropping the top
+// levels of the least recently drawn arrays first.
+class TextureStreamer {
+public:
+    static TextureStreaming settings;
+
+    // Level a newly uploaded array starts at.
+    static int initialLevel(const TextureArray& array);
+    // Called by draws: level is the finest level of array they sample.
+    static void request(TextureArray& array, int level);
+    // Once per frame on the GL thread. Spends at most about budgetMs on uploads.
+    static void update(std::vector<DataTex>& models, double budgetMs);
+
+    // Video memory of levels firstLevel and up of array.
+    static size_t bytes(const TextureArray& array, int firstLevel);
+
+    struct Stats {
+        size_t residentBytes = 0; // streamed arrays as currently stored
+        size_t fullBytes = 0;     // the same arrays with every level
+    };
+    static Stats stats(const std::vector<DataTex>& models);
+
+private:
+    // Rebuilds array with storage from level, copying the levels both share.
+    static void resize(TextureArray& array, int level);
+
+    static uint64_t frame;
+};
+}
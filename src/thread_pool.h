@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gl {
+
+// Fixed set of worker threads running submitted tasks in FIFO order. The
+// destructor finishes the queued tasks before joining.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = defaultThreadCount());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    [[nodiscard]] size_t size() const { return m_workers.size(); }
+
+    // All hardware threads but the one driving the window, at least one.
+    static unsigned defaultThreadCount();
+
+private:
+    void run();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+};
+}
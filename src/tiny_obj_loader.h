@@ -527,8 +527,17 @@ struct ObjReaderConfig {
   ///
   std::string mtl_search_path;
 
+  ///
+  /// Number of threads used to tokenize the .obj text in ParseFromFile.
+  /// 1 = parse on the calling thread. The result is identical for any value.
+  ///
+  int num_threads;
+
   ObjReaderConfig()
-      : triangulate(true), triangulation_method("simple"), vertex_color(true) {}
+      : triangulate(true),
+        triangulation_method("simple"),
+        vertex_color(true),
+        num_threads(1) {}
 };
 
 ///
@@ -660,13 +669,33 @@ bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
 #include <cmath>
 #include <cstddef>
 #include <cstdlib>
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
 #include <fstream>
 #include <limits>
+#include <mutex>
 #include <set>
 #include <sstream>
+#include <string_view>
+#include <thread>
 #include <utility>
 
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
 
 #ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
@@ -798,6 +827,125 @@ static std::istream &safeGetline(std::istream &is, std::string &t) {
   return is;
 }
 
+// Read-only mapping of one window of a file at a time. Parsing window by
+// window keeps the mapped footprint bounded, so files larger than the address
+// space or physical memory can be read without copying them into memory.
+class mapped_file_window {
+ public:
+  mapped_file_window()
+      : data_(NULL),
+        length_(0),
+        size_(0),
+#ifdef _WIN32
+        file_(INVALID_HANDLE_VALUE),
+        mapping_(NULL)
+#else
+        fd_(-1)
+#endif
+  {
+  }
+
+  ~mapped_file_window() {
+    unmap();
+#ifdef _WIN32
+    if (mapping_) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+    if (fd_ >= 0) close(fd_);
+#endif
+  }
+
+  bool open(const std::string &filename) {
+#ifdef _WIN32
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_ == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) return false;
+    size_ = static_cast<unsigned long long>(size.QuadPart);
+    if (size_ == 0) return true;
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    return mapping_ != NULL;
+#else
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) return false;
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    size_ = static_cast<unsigned long long>(st.st_size);
+    return true;
+#endif
+  }
+
+  unsigned long long size() const { return size_; }
+
+  // Window offsets must be a multiple of this.
+  static size_t granularity() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return static_cast<size_t>(info.dwAllocationGranularity);
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+  }
+
+  // Maps [offset, offset + length), replacing the previous window. Returns
+  // NULL on failure.
+  const char *map(unsigned long long offset, size_t length) {
+    unmap();
+    if (length == 0) return NULL;
+#ifdef _WIN32
+    void *p = MapViewOfFile(mapping_, FILE_MAP_READ,
+                            static_cast<DWORD>(offset >> 32),
+                            static_cast<DWORD>(offset & 0xffffffffu), length);
+    if (!p) return NULL;
+#else
+    void *p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd_,
+                   static_cast<off_t>(offset));
+    if (p == MAP_FAILED) return NULL;
+    madvise(p, length, MADV_SEQUENTIAL);
+#endif
+    data_ = static_cast<const char *>(p);
+    length_ = length;
+    return data_;
+  }
+
+  void unmap() {
+    if (!data_) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(const_cast<char *>(data_), length_);
+#endif
+    data_ = NULL;
+    length_ = 0;
+  }
+
+ private:
+  mapped_file_window(const mapped_file_window &);
+  mapped_file_window &operator=(const mapped_file_window &);
+
+  const char *data_;
+  size_t length_;
+  unsigned long long size_;
+#ifdef _WIN32
+  HANDLE file_;
+  HANDLE mapping_;
+#else
+  int fd_;
+#endif
+};
+
+// Read-only std::streambuf over a memory range, so istream based parsers can
+// read mapped bytes in place.
+class memory_streambuf : public std::streambuf {
+ public:
+  memory_streambuf(const char *data, size_t length) {
+    char *p = const_cast<char *>(data);
+    setg(p, p, p + length);
+  }
+};
+
 #define IS_SPACE(x) (((x) == ' ') || ((x) == '\t'))
 #define IS_DIGIT(x) \
   (static_cast<unsigned int>((x) - '0') < static_cast<unsigned int>(10))
@@ -2467,6 +2615,35 @@ void LoadMtl(std::map<std::string, int> *material_map,
   }
 }
 
+// Parses a .mtl file straight out of its mapping. Returns false if the file
+// can't be opened.
+static bool LoadMtlFile(const std::string &filepath,
+                        std::map<std::string, int> *material_map,
+                        std::vector<material_t> *materials, std::string *warn,
+                        std::string *err) {
+  mapped_file_window file;
+  if (!file.open(filepath)) {
+    return false;
+  }
+
+  // .mtl files are small, one window covers the whole file.
+  size_t length = static_cast<size_t>(file.size());
+  const char *data = file.map(0, length);
+  if (!data && length > 0) {
+    std::ifstream matIStream(filepath.c_str());
+    if (!matIStream) {
+      return false;
+    }
+    LoadMtl(material_map, materials, &matIStream, warn, err);
+    return true;
+  }
+
+  memory_streambuf buf(data, data ? length : 0);
+  std::istream matIStream(&buf);
+  LoadMtl(material_map, materials, &matIStream, warn, err);
+  return true;
+}
+
 bool MaterialFileReader::operator()(const std::string &matId,
                                     std::vector<material_t> *materials,
                                     std::map<std::string, int> *matMap,
@@ -2490,10 +2667,7 @@ bool MaterialFileReader::operator()(const std::string &matId,
     for (size_t i = 0; i < paths.size(); i++) {
       std::string filepath = JoinPath(paths[i], matId);
 
-      std::ifstream matIStream(filepath.c_str());
-      if (matIStream) {
-        LoadMtl(matMap, materials, &matIStream, warn, err);
-
+      if (LoadMtlFile(filepath, matMap, materials, warn, err)) {
         return true;
       }
     }
@@ -2508,10 +2682,7 @@ bool MaterialFileReader::operator()(const std::string &matId,
 
   } else {
     std::string filepath = matId;
-    std::ifstream matIStream(filepath.c_str());
-    if (matIStream) {
-      LoadMtl(matMap, materials, &matIStream, warn, err);
-
+    if (LoadMtlFile(filepath, matMap, materials, warn, err)) {
       return true;
     }
 
@@ -2582,13 +2753,9 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
                  triangulate, default_vcols_fallback);
 }
 
-bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
-             std::vector<material_t> *materials, std::string *warn,
-             std::string *err, std::istream *inStream,
-             MaterialReader *readMatFn /*= NULL*/, bool triangulate,
-             bool default_vcols_fallback) {
-  std::stringstream errss;
-
+// Parser state of LoadObj. Shared by the serial line loop and the ordered merge
+// of the parallel path, so both produce identical output.
+struct obj_parse_state {
   std::vector<real_t> v;
   std::vector<real_t> vertex_weights;  // optional [w] component in `v`
   std::vector<real_t> vn;
@@ -2602,516 +2769,536 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   // material
   std::set<std::string> material_filenames;
   std::map<std::string, int> material_map;
-  int material = -1;
+  int material;
 
   // smoothing group id
-  unsigned int current_smoothing_id =
-      0;  // Initial value. 0 means no smoothing.
+  unsigned int current_smoothing_id;  // 0 means no smoothing.
 
-  int greatest_v_idx = -1;
-  int greatest_vn_idx = -1;
-  int greatest_vt_idx = -1;
+  int greatest_v_idx;
+  int greatest_vn_idx;
+  int greatest_vt_idx;
 
   shape_t shape;
 
-  bool found_all_colors = true;  // check if all 'v' line has color info
-
-  size_t line_num = 0;
-  std::string linebuf;
-  while (inStream->peek() != -1) {
-    safeGetline(*inStream, linebuf);
+  bool found_all_colors;  // check if all 'v' line has color info
 
-    line_num++;
+  size_t line_num;
 
-    // Trim newline '\r\n' or '\n'
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\n')
-        linebuf.erase(linebuf.size() - 1);
-    }
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\r')
-        linebuf.erase(linebuf.size() - 1);
-    }
+  obj_parse_state()
+      : material(-1),
+        current_smoothing_id(0),
+        greatest_v_idx(-1),
+        greatest_vn_idx(-1),
+        greatest_vt_idx(-1),
+        found_all_colors(true),
+        line_num(0) {}
+};
 
-    // Skip if empty line.
-    if (linebuf.empty()) {
-      continue;
+// Parses one non-empty, non-comment line. `token` points past leading
+// whitespace. Returns false on a fatal parse error.
+static bool ParseObjLine(obj_parse_state *state, const char *token,
+                         std::vector<shape_t> *shapes,
+                         std::vector<material_t> *materials, std::string *warn,
+                         std::string *err, MaterialReader *readMatFn,
+                         bool triangulate, bool default_vcols_fallback) {
+  std::vector<real_t> &v = state->v;
+  std::vector<real_t> &vertex_weights = state->vertex_weights;
+  std::vector<real_t> &vn = state->vn;
+  std::vector<real_t> &vt = state->vt;
+  std::vector<real_t> &vc = state->vc;
+  std::vector<skin_weight_t> &vw = state->vw;
+  std::vector<tag_t> &tags = state->tags;
+  PrimGroup &prim_group = state->prim_group;
+  std::string &name = state->name;
+  std::set<std::string> &material_filenames = state->material_filenames;
+  std::map<std::string, int> &material_map = state->material_map;
+  int &material = state->material;
+  unsigned int &current_smoothing_id = state->current_smoothing_id;
+  int &greatest_v_idx = state->greatest_v_idx;
+  int &greatest_vn_idx = state->greatest_vn_idx;
+  int &greatest_vt_idx = state->greatest_vt_idx;
+  shape_t &shape = state->shape;
+  bool &found_all_colors = state->found_all_colors;
+  const size_t line_num = state->line_num;
+
+  // vertex
+  if (token[0] == 'v' && IS_SPACE((token[1]))) {
+    token += 2;
+    real_t x, y, z;
+    real_t r, g, b;
+
+    int num_components = parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+    found_all_colors &= (num_components == 6);
+
+    v.push_back(x);
+    v.push_back(y);
+    v.push_back(z);
+
+    vertex_weights.push_back(
+        r);  // r = w, and initialized to 1.0 when `w` component is not found.
+
+    if ((num_components == 6) || default_vcols_fallback) {
+      vc.push_back(r);
+      vc.push_back(g);
+      vc.push_back(b);
     }
 
-    // Skip leading space.
-    const char *token = linebuf.c_str();
-    token += strspn(token, " \t");
-
-    assert(token);
-    if (token[0] == '\0') continue;  // empty line
-
-    if (token[0] == '#') continue;  // comment line
-
-    // vertex
-    if (token[0] == 'v' && IS_SPACE((token[1]))) {
-      token += 2;
-      real_t x, y, z;
-      real_t r, g, b;
-
-      int num_components = parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
-      found_all_colors &= (num_components == 6);
-
-      v.push_back(x);
-      v.push_back(y);
-      v.push_back(z);
-
-      vertex_weights.push_back(
-          r);  // r = w, and initialized to 1.0 when `w` component is not found.
-
-      if ((num_components == 6) || default_vcols_fallback) {
-        vc.push_back(r);
-        vc.push_back(g);
-        vc.push_back(b);
-      }
+    return true;
+  }
 
-      continue;
-    }
+  // normal
+  if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+    token += 3;
+    real_t x, y, z;
+    parseReal3(&x, &y, &z, &token);
+    vn.push_back(x);
+    vn.push_back(y);
+    vn.push_back(z);
+    return true;
+  }
 
-    // normal
-    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
-      token += 3;
-      real_t x, y, z;
-      parseReal3(&x, &y, &z, &token);
-      vn.push_back(x);
-      vn.push_back(y);
-      vn.push_back(z);
-      continue;
-    }
+  // texcoord
+  if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+    token += 3;
+    real_t x, y;
+    parseReal2(&x, &y, &token);
+    vt.push_back(x);
+    vt.push_back(y);
+    return true;
+  }
 
-    // texcoord
-    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
-      token += 3;
-      real_t x, y;
-      parseReal2(&x, &y, &token);
-      vt.push_back(x);
-      vt.push_back(y);
-      continue;
-    }
+  // skin weight. tinyobj extension
+  if (token[0] == 'v' && token[1] == 'w' && IS_SPACE((token[2]))) {
+    token += 3;
 
-    // skin weight. tinyobj extension
-    if (token[0] == 'v' && token[1] == 'w' && IS_SPACE((token[2]))) {
-      token += 3;
+    // vw <vid> <joint_0> <weight_0> <joint_1> <weight_1> ...
+    // example:
+    // vw 0 0 0.25 1 0.25 2 0.5
 
-      // vw <vid> <joint_0> <weight_0> <joint_1> <weight_1> ...
-      // example:
-      // vw 0 0 0.25 1 0.25 2 0.5
+    // TODO(syoyo): Add syntax check
+    int vid = 0;
+    vid = parseInt(&token);
 
-      // TODO(syoyo): Add syntax check
-      int vid = 0;
-      vid = parseInt(&token);
+    skin_weight_t sw;
 
-      skin_weight_t sw;
+    sw.vertex_id = vid;
 
-      sw.vertex_id = vid;
+    while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+      real_t j, w;
+      // joint_id should not be negative, weight may be negative
+      // TODO(syoyo): # of elements check
+      parseReal2(&j, &w, &token, -1.0);
 
-      while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
-        real_t j, w;
-        // joint_id should not be negative, weight may be negative
-        // TODO(syoyo): # of elements check
-        parseReal2(&j, &w, &token, -1.0);
-
-        if (j < static_cast<real_t>(0)) {
-          if (err) {
-            std::stringstream ss;
-            ss << "Failed parse `vw' line. joint_id is negative. "
-                  "line "
-               << line_num << ".)\n";
-            (*err) += ss.str();
-          }
-          return false;
+      if (j < static_cast<real_t>(0)) {
+        if (err) {
+          std::stringstream ss;
+          ss << "Failed parse `vw' line. joint_id is negative. "
+                "line "
+             << line_num << ".)\n";
+          (*err) += ss.str();
         }
+        return false;
+      }
 
-        joint_and_weight_t jw;
-
-        jw.joint_id = int(j);
-        jw.weight = w;
+      joint_and_weight_t jw;
 
-        sw.weightValues.push_back(jw);
+      jw.joint_id = int(j);
+      jw.weight = w;
 
-        size_t n = strspn(token, " \t\r");
-        token += n;
-      }
+      sw.weightValues.push_back(jw);
 
-      vw.push_back(sw);
+      size_t n = strspn(token, " \t\r");
+      token += n;
     }
 
-    warning_context context;
-    context.warn = warn;
-    context.line_number = line_num;
-
-    // line
-    if (token[0] == 'l' && IS_SPACE((token[1]))) {
-      token += 2;
+    vw.push_back(sw);
+  }
 
-      __line_t line;
+  warning_context context;
+  context.warn = warn;
+  context.line_number = line_num;
 
-      while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
-        vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
-          if (err) {
-            (*err) +=
-                "Failed to parse `l' line (e.g. a zero value for vertex index. "
-                "Line " +
-                toString(line_num) + ").\n";
-          }
-          return false;
+  // line
+  if (token[0] == 'l' && IS_SPACE((token[1]))) {
+    token += 2;
+
+    __line_t line;
+
+    while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+      vertex_index_t vi;
+      if (!parseTriple(&token, static_cast<int>(v.size() / 3),
+                       static_cast<int>(vn.size() / 3),
+                       static_cast<int>(vt.size() / 2), &vi, context)) {
+        if (err) {
+          (*err) +=
+              "Failed to parse `l' line (e.g. a zero value for vertex index. "
+              "Line " +
+              toString(line_num) + ").\n";
         }
-
-        line.vertex_indices.push_back(vi);
-
-        size_t n = strspn(token, " \t\r");
-        token += n;
+        return false;
       }
 
-      prim_group.lineGroup.push_back(line);
+      line.vertex_indices.push_back(vi);
 
-      continue;
+      size_t n = strspn(token, " \t\r");
+      token += n;
     }
 
-    // points
-    if (token[0] == 'p' && IS_SPACE((token[1]))) {
-      token += 2;
+    prim_group.lineGroup.push_back(line);
 
-      __points_t pts;
+    return true;
+  }
 
-      while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
-        vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
-          if (err) {
-            (*err) +=
-                "Failed to parse `p' line (e.g. a zero value for vertex index. "
-                "Line " +
-                toString(line_num) + ").\n";
-          }
-          return false;
+  // points
+  if (token[0] == 'p' && IS_SPACE((token[1]))) {
+    token += 2;
+
+    __points_t pts;
+
+    while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+      vertex_index_t vi;
+      if (!parseTriple(&token, static_cast<int>(v.size() / 3),
+                       static_cast<int>(vn.size() / 3),
+                       static_cast<int>(vt.size() / 2), &vi, context)) {
+        if (err) {
+          (*err) +=
+              "Failed to parse `p' line (e.g. a zero value for vertex index. "
+              "Line " +
+              toString(line_num) + ").\n";
         }
-
-        pts.vertex_indices.push_back(vi);
-
-        size_t n = strspn(token, " \t\r");
-        token += n;
+        return false;
       }
 
-      prim_group.pointsGroup.push_back(pts);
+      pts.vertex_indices.push_back(vi);
 
-      continue;
+      size_t n = strspn(token, " \t\r");
+      token += n;
     }
 
-    // face
-    if (token[0] == 'f' && IS_SPACE((token[1]))) {
-      token += 2;
-      token += strspn(token, " \t");
+    prim_group.pointsGroup.push_back(pts);
 
-      face_t face;
+    return true;
+  }
 
-      face.smoothing_group_id = current_smoothing_id;
-      face.vertex_indices.reserve(3);
+  // face
+  if (token[0] == 'f' && IS_SPACE((token[1]))) {
+    token += 2;
+    token += strspn(token, " \t");
 
-      while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
-        vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi, context)) {
-          if (err) {
-            (*err) +=
-                "Failed to parse `f' line (e.g. a zero value for vertex index "
-                "or invalid relative vertex index). Line " +
-                toString(line_num) + ").\n";
-          }
-          return false;
+    face_t face;
+
+    face.smoothing_group_id = current_smoothing_id;
+    face.vertex_indices.reserve(3);
+
+    while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+      vertex_index_t vi;
+      if (!parseTriple(&token, static_cast<int>(v.size() / 3),
+                       static_cast<int>(vn.size() / 3),
+                       static_cast<int>(vt.size() / 2), &vi, context)) {
+        if (err) {
+          (*err) +=
+              "Failed to parse `f' line (e.g. a zero value for vertex index "
+              "or invalid relative vertex index). Line " +
+              toString(line_num) + ").\n";
         }
-
-        greatest_v_idx = greatest_v_idx > vi.v_idx ? greatest_v_idx : vi.v_idx;
-        greatest_vn_idx =
-            greatest_vn_idx > vi.vn_idx ? greatest_vn_idx : vi.vn_idx;
-        greatest_vt_idx =
-            greatest_vt_idx > vi.vt_idx ? greatest_vt_idx : vi.vt_idx;
-
-        face.vertex_indices.push_back(vi);
-        size_t n = strspn(token, " \t\r");
-        token += n;
+        return false;
       }
 
-      // replace with emplace_back + std::move on C++11
-      prim_group.faceGroup.push_back(face);
+      greatest_v_idx = greatest_v_idx > vi.v_idx ? greatest_v_idx : vi.v_idx;
+      greatest_vn_idx =
+          greatest_vn_idx > vi.vn_idx ? greatest_vn_idx : vi.vn_idx;
+      greatest_vt_idx =
+          greatest_vt_idx > vi.vt_idx ? greatest_vt_idx : vi.vt_idx;
 
-      continue;
+      face.vertex_indices.push_back(vi);
+      size_t n = strspn(token, " \t\r");
+      token += n;
     }
 
-    // use mtl
-    if ((0 == strncmp(token, "usemtl", 6))) {
-      token += 6;
-      std::string namebuf = parseString(&token);
+    // replace with emplace_back + std::move on C++11
+    prim_group.faceGroup.push_back(face);
 
-      int newMaterialId = -1;
-      std::map<std::string, int>::const_iterator it =
-          material_map.find(namebuf);
-      if (it != material_map.end()) {
-        newMaterialId = it->second;
-      } else {
-        // { error!! material not found }
-        if (warn) {
-          (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
-        }
-      }
+    return true;
+  }
 
-      if (newMaterialId != material) {
-        // Create per-face material. Thus we don't add `shape` to `shapes` at
-        // this time.
-        // just clear `faceGroup` after `exportGroupsToShape()` call.
-        exportGroupsToShape(&shape, prim_group, tags, material, name,
-                            triangulate, v, warn);
-        prim_group.faceGroup.clear();
-        material = newMaterialId;
+  // use mtl
+  if ((0 == strncmp(token, "usemtl", 6))) {
+    token += 6;
+    std::string namebuf = parseString(&token);
+
+    int newMaterialId = -1;
+    std::map<std::string, int>::const_iterator it =
+        material_map.find(namebuf);
+    if (it != material_map.end()) {
+      newMaterialId = it->second;
+    } else {
+      // { error!! material not found }
+      if (warn) {
+        (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
       }
+    }
 
-      continue;
+    if (newMaterialId != material) {
+      // Create per-face material. Thus we don't add `shape` to `shapes` at
+      // this time.
+      // just clear `faceGroup` after `exportGroupsToShape()` call.
+      exportGroupsToShape(&shape, prim_group, tags, material, name,
+                          triangulate, v, warn);
+      prim_group.faceGroup.clear();
+      material = newMaterialId;
     }
 
-    // load mtl
-    if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
-      if (readMatFn) {
-        token += 7;
+    return true;
+  }
 
-        std::vector<std::string> filenames;
-        SplitString(std::string(token), ' ', '\\', filenames);
+  // load mtl
+  if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
+    if (readMatFn) {
+      token += 7;
 
-        if (filenames.empty()) {
-          if (warn) {
-            std::stringstream ss;
-            ss << "Looks like empty filename for mtllib. Use default "
-                  "material (line "
-               << line_num << ".)\n";
+      std::vector<std::string> filenames;
+      SplitString(std::string(token), ' ', '\\', filenames);
+
+      if (filenames.empty()) {
+        if (warn) {
+          std::stringstream ss;
+          ss << "Looks like empty filename for mtllib. Use default "
+                "material (line "
+             << line_num << ".)\n";
 
-            (*warn) += ss.str();
+          (*warn) += ss.str();
+        }
+      } else {
+        bool found = false;
+        for (size_t s = 0; s < filenames.size(); s++) {
+          if (material_filenames.count(filenames[s]) > 0) {
+            found = true;
+            continue;
           }
-        } else {
-          bool found = false;
-          for (size_t s = 0; s < filenames.size(); s++) {
-            if (material_filenames.count(filenames[s]) > 0) {
-              found = true;
-              continue;
-            }
 
-            std::string warn_mtl;
-            std::string err_mtl;
-            bool ok = (*readMatFn)(filenames[s].c_str(), materials,
-                                   &material_map, &warn_mtl, &err_mtl);
-            if (warn && (!warn_mtl.empty())) {
-              (*warn) += warn_mtl;
-            }
+          std::string warn_mtl;
+          std::string err_mtl;
+          bool ok = (*readMatFn)(filenames[s].c_str(), materials,
+                                 &material_map, &warn_mtl, &err_mtl);
+          if (warn && (!warn_mtl.empty())) {
+            (*warn) += warn_mtl;
+          }
 
-            if (err && (!err_mtl.empty())) {
-              (*err) += err_mtl;
-            }
+          if (err && (!err_mtl.empty())) {
+            (*err) += err_mtl;
+          }
 
-            if (ok) {
-              found = true;
-              material_filenames.insert(filenames[s]);
-              break;
-            }
+          if (ok) {
+            found = true;
+            material_filenames.insert(filenames[s]);
+            break;
           }
+        }
 
-          if (!found) {
-            if (warn) {
-              (*warn) +=
-                  "Failed to load material file(s). Use default "
-                  "material.\n";
-            }
+        if (!found) {
+          if (warn) {
+            (*warn) +=
+                "Failed to load material file(s). Use default "
+                "material.\n";
           }
         }
       }
-
-      continue;
     }
 
-    // group name
-    if (token[0] == 'g' && IS_SPACE((token[1]))) {
-      // flush previous face group.
-      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                     triangulate, v, warn);
-      (void)ret;  // return value not used.
+    return true;
+  }
 
-      if (shape.mesh.indices.size() > 0) {
-        shapes->push_back(shape);
-      }
+  // group name
+  if (token[0] == 'g' && IS_SPACE((token[1]))) {
+    // flush previous face group.
+    bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
+                                   triangulate, v, warn);
+    (void)ret;  // return value not used.
 
-      shape = shape_t();
+    if (shape.mesh.indices.size() > 0) {
+      shapes->push_back(shape);
+    }
 
-      // material = -1;
-      prim_group.clear();
+    shape = shape_t();
 
-      std::vector<std::string> names;
+    // material = -1;
+    prim_group.clear();
 
-      while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
-        std::string str = parseString(&token);
-        names.push_back(str);
-        token += strspn(token, " \t\r");  // skip tag
-      }
+    std::vector<std::string> names;
 
-      // names[0] must be 'g'
+    while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+      std::string str = parseString(&token);
+      names.push_back(str);
+      token += strspn(token, " \t\r");  // skip tag
+    }
 
-      if (names.size() < 2) {
-        // 'g' with empty names
-        if (warn) {
-          std::stringstream ss;
-          ss << "Empty group name. line: " << line_num << "\n";
-          (*warn) += ss.str();
-          name = "";
-        }
-      } else {
-        std::stringstream ss;
-        ss << names[1];
+    // names[0] must be 'g'
 
-        // tinyobjloader does not support multiple groups for a primitive.
-        // Currently we concatinate multiple group names with a space to get
-        // single group name.
+    if (names.size() < 2) {
+      // 'g' with empty names
+      if (warn) {
+        std::stringstream ss;
+        ss << "Empty group name. line: " << line_num << "\n";
+        (*warn) += ss.str();
+        name = "";
+      }
+    } else {
+      std::stringstream ss;
+      ss << names[1];
 
-        for (size_t i = 2; i < names.size(); i++) {
-          ss << " " << names[i];
-        }
+      // tinyobjloader does not support multiple groups for a primitive.
+      // Currently we concatinate multiple group names with a space to get
+      // single group name.
 
-        name = ss.str();
+      for (size_t i = 2; i < names.size(); i++) {
+        ss << " " << names[i];
       }
 
-      continue;
+      name = ss.str();
     }
 
-    // object name
-    if (token[0] == 'o' && IS_SPACE((token[1]))) {
-      // flush previous face group.
-      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                     triangulate, v, warn);
-      (void)ret;  // return value not used.
-
-      if (shape.mesh.indices.size() > 0 || shape.lines.indices.size() > 0 ||
-          shape.points.indices.size() > 0) {
-        shapes->push_back(shape);
-      }
-
-      // material = -1;
-      prim_group.clear();
-      shape = shape_t();
+    return true;
+  }
 
-      // @todo { multiple object name? }
-      token += 2;
-      std::stringstream ss;
-      ss << token;
-      name = ss.str();
+  // object name
+  if (token[0] == 'o' && IS_SPACE((token[1]))) {
+    // flush previous face group.
+    bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
+                                   triangulate, v, warn);
+    (void)ret;  // return value not used.
 
-      continue;
+    if (shape.mesh.indices.size() > 0 || shape.lines.indices.size() > 0 ||
+        shape.points.indices.size() > 0) {
+      shapes->push_back(shape);
     }
 
-    if (token[0] == 't' && IS_SPACE(token[1])) {
-      const int max_tag_nums = 8192;  // FIXME(syoyo): Parameterize.
-      tag_t tag;
+    // material = -1;
+    prim_group.clear();
+    shape = shape_t();
 
-      token += 2;
+    // @todo { multiple object name? }
+    token += 2;
+    std::stringstream ss;
+    ss << token;
+    name = ss.str();
 
-      tag.name = parseString(&token);
+    return true;
+  }
 
-      tag_sizes ts = parseTagTriple(&token);
+  if (token[0] == 't' && IS_SPACE(token[1])) {
+    const int max_tag_nums = 8192;  // FIXME(syoyo): Parameterize.
+    tag_t tag;
 
-      if (ts.num_ints < 0) {
-        ts.num_ints = 0;
-      }
-      if (ts.num_ints > max_tag_nums) {
-        ts.num_ints = max_tag_nums;
-      }
+    token += 2;
 
-      if (ts.num_reals < 0) {
-        ts.num_reals = 0;
-      }
-      if (ts.num_reals > max_tag_nums) {
-        ts.num_reals = max_tag_nums;
-      }
+    tag.name = parseString(&token);
 
-      if (ts.num_strings < 0) {
-        ts.num_strings = 0;
-      }
-      if (ts.num_strings > max_tag_nums) {
-        ts.num_strings = max_tag_nums;
-      }
+    tag_sizes ts = parseTagTriple(&token);
 
-      tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+    if (ts.num_ints < 0) {
+      ts.num_ints = 0;
+    }
+    if (ts.num_ints > max_tag_nums) {
+      ts.num_ints = max_tag_nums;
+    }
 
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
-        tag.intValues[i] = parseInt(&token);
-      }
+    if (ts.num_reals < 0) {
+      ts.num_reals = 0;
+    }
+    if (ts.num_reals > max_tag_nums) {
+      ts.num_reals = max_tag_nums;
+    }
 
-      tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
-        tag.floatValues[i] = parseReal(&token);
-      }
+    if (ts.num_strings < 0) {
+      ts.num_strings = 0;
+    }
+    if (ts.num_strings > max_tag_nums) {
+      ts.num_strings = max_tag_nums;
+    }
 
-      tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-        tag.stringValues[i] = parseString(&token);
-      }
+    tag.intValues.resize(static_cast<size_t>(ts.num_ints));
 
-      tags.push_back(tag);
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
+      tag.intValues[i] = parseInt(&token);
+    }
 
-      continue;
+    tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
+      tag.floatValues[i] = parseReal(&token);
     }
 
-    if (token[0] == 's' && IS_SPACE(token[1])) {
-      // smoothing group id
-      token += 2;
+    tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
+      tag.stringValues[i] = parseString(&token);
+    }
 
-      // skip space.
-      token += strspn(token, " \t");  // skip space
+    tags.push_back(tag);
 
-      if (token[0] == '\0') {
-        continue;
-      }
+    return true;
+  }
 
-      if (token[0] == '\r' || token[1] == '\n') {
-        continue;
-      }
+  if (token[0] == 's' && IS_SPACE(token[1])) {
+    // smoothing group id
+    token += 2;
+
+    // skip space.
+    token += strspn(token, " \t");  // skip space
 
-      if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' &&
-          token[2] == 'f') {
+    if (token[0] == '\0') {
+      return true;
+    }
+
+    if (token[0] == '\r' || token[1] == '\n') {
+      return true;
+    }
+
+    if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' &&
+        token[2] == 'f') {
+      current_smoothing_id = 0;
+    } else {
+      // assume number
+      int smGroupId = parseInt(&token);
+      if (smGroupId < 0) {
+        // parse error. force set to 0.
+        // FIXME(syoyo): Report warning.
         current_smoothing_id = 0;
       } else {
-        // assume number
-        int smGroupId = parseInt(&token);
-        if (smGroupId < 0) {
-          // parse error. force set to 0.
-          // FIXME(syoyo): Report warning.
-          current_smoothing_id = 0;
-        } else {
-          current_smoothing_id = static_cast<unsigned int>(smGroupId);
-        }
+        current_smoothing_id = static_cast<unsigned int>(smGroupId);
       }
+    }
 
-      continue;
-    }  // smoothing group id
+    return true;
+  }  // smoothing group id
 
-    // Ignore unknown command.
-  }
+  // Ignore unknown command.
+  return true;
+}
+
+// Flushes the last primitive group and moves the parsed attributes out.
+static bool FinishObj(obj_parse_state *state, attrib_t *attrib,
+                      std::vector<shape_t> *shapes, std::string *warn,
+                      bool triangulate, bool default_vcols_fallback) {
+  std::vector<real_t> &v = state->v;
+  std::vector<real_t> &vn = state->vn;
+  std::vector<real_t> &vt = state->vt;
+  std::vector<real_t> &vc = state->vc;
+  PrimGroup &prim_group = state->prim_group;
+  shape_t &shape = state->shape;
+  const size_t line_num = state->line_num;
 
   // not all vertices have colors, no default colors desired? -> clear colors
-  if (!found_all_colors && !default_vcols_fallback) {
+  if (!state->found_all_colors && !default_vcols_fallback) {
     vc.clear();
   }
 
-  if (greatest_v_idx >= static_cast<int>(v.size() / 3)) {
+  if (state->greatest_v_idx >= static_cast<int>(v.size() / 3)) {
     if (warn) {
       std::stringstream ss;
       ss << "Vertex indices out of bounds (line " << line_num << ".)\n\n";
       (*warn) += ss.str();
     }
   }
-  if (greatest_vn_idx >= static_cast<int>(vn.size() / 3)) {
+  if (state->greatest_vn_idx >= static_cast<int>(vn.size() / 3)) {
     if (warn) {
       std::stringstream ss;
       ss << "Vertex normal indices out of bounds (line " << line_num
@@ -3119,7 +3306,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       (*warn) += ss.str();
     }
   }
-  if (greatest_vt_idx >= static_cast<int>(vt.size() / 2)) {
+  if (state->greatest_vt_idx >= static_cast<int>(vt.size() / 2)) {
     if (warn) {
       std::stringstream ss;
       ss << "Vertex texcoord indices out of bounds (line " << line_num
@@ -3128,8 +3315,9 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     }
   }
 
-  bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                 triangulate, v, warn);
+  bool ret = exportGroupsToShape(&shape, prim_group, state->tags,
+                                 state->material, state->name, triangulate, v,
+                                 warn);
   // exportGroupsToShape return false when `usemtl` is called in the last
   // line.
   // we also add `shape` to `shapes` when `shape.mesh` has already some
@@ -3140,21 +3328,557 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   }
   prim_group.clear();  // for safety
 
-  if (err) {
-    (*err) += errss.str();
-  }
-
   attrib->vertices.swap(v);
-  attrib->vertex_weights.swap(vertex_weights);
+  attrib->vertex_weights.swap(state->vertex_weights);
   attrib->normals.swap(vn);
   attrib->texcoords.swap(vt);
   attrib->texcoord_ws.swap(vt);
   attrib->colors.swap(vc);
-  attrib->skin_weights.swap(vw);
+  attrib->skin_weights.swap(state->vw);
 
   return true;
 }
 
+bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
+             std::vector<material_t> *materials, std::string *warn,
+             std::string *err, std::istream *inStream,
+             MaterialReader *readMatFn /*= NULL*/, bool triangulate,
+             bool default_vcols_fallback) {
+  obj_parse_state state;
+
+  std::string linebuf;
+  while (inStream->peek() != -1) {
+    safeGetline(*inStream, linebuf);
+
+    state.line_num++;
+
+    // Trim newline '\r\n' or '\n'
+    if (linebuf.size() > 0) {
+      if (linebuf[linebuf.size() - 1] == '\n')
+        linebuf.erase(linebuf.size() - 1);
+    }
+    if (linebuf.size() > 0) {
+      if (linebuf[linebuf.size() - 1] == '\r')
+        linebuf.erase(linebuf.size() - 1);
+    }
+
+    // Skip if empty line.
+    if (linebuf.empty()) {
+      continue;
+    }
+
+    // Skip leading space.
+    const char *token = linebuf.c_str();
+    token += strspn(token, " \t");
+
+    assert(token);
+    if (token[0] == '\0') continue;  // empty line
+
+    if (token[0] == '#') continue;  // comment line
+
+    if (!ParseObjLine(&state, token, shapes, materials, warn, err, readMatFn,
+                      triangulate, default_vcols_fallback)) {
+      return false;
+    }
+  }
+
+  return FinishObj(&state, attrib, shapes, warn, triangulate,
+                   default_vcols_fallback);
+}
+
+// Marks a texcoord/normal index that is absent from a face triple.
+static const int kAbsentIndex = (std::numeric_limits<int>::min)();
+
+// Pre-parsed contents of one newline-aligned chunk of .obj text. The bulk
+// `v`/`vn`/`vt`/`f` lines are tokenized on a worker thread; every other line
+// is kept verbatim and replayed through ParseObjLine during the ordered merge.
+struct obj_chunk {
+  enum command_type {
+    COMMAND_SKIP,  // empty or comment line
+    COMMAND_V,
+    COMMAND_VN,
+    COMMAND_VT,
+    COMMAND_F,
+    COMMAND_OTHER
+  };
+
+  // Run of `count` consecutive lines of the same type.
+  struct command {
+    command_type type;
+    size_t count;
+  };
+
+  std::vector<command> commands;
+  std::vector<real_t> v;                     // x, y, z, r, g, b per `v` line
+  std::vector<unsigned char> v_components;   // parseVertexWithColor() result
+  std::vector<real_t> vn;                    // 3 per `vn` line
+  std::vector<real_t> vt;                    // 2 per `vt` line
+  std::vector<int> face_sizes;               // triples per `f` line
+  std::vector<vertex_index_t> face_indices;  // unfixed triples
+  std::vector<std::string> other_lines;
+
+  void push(command_type type) {
+    if (!commands.empty() && commands.back().type == type) {
+      commands.back().count++;
+      return;
+    }
+    command c;
+    c.type = type;
+    c.count = 1;
+    commands.push_back(c);
+  }
+};
+
+// In-place counterparts of parseReal() and parseTriple() for the bulk
+// `v`/`vn`/`vt`/`f` lines. Tokens are read straight out of the (mapped) text
+// as string_views; a line is not NUL terminated, so every scan is bounded by
+// the view instead.
+static inline void skipSpaceView(std::string_view *sv, const char *chars) {
+  size_t n = sv->find_first_not_of(chars);
+  sv->remove_prefix(n == std::string_view::npos ? sv->size() : n);
+}
+
+static inline std::string_view nextTokenView(std::string_view *sv,
+                                             const char *delims) {
+  size_t n = (std::min)(sv->find_first_of(delims), sv->size());
+  std::string_view token = sv->substr(0, n);
+  sv->remove_prefix(n);
+  return token;
+}
+
+static inline bool parseRealView(std::string_view *sv, real_t *out) {
+  skipSpaceView(sv, " \t");
+  std::string_view token = nextTokenView(sv, " \t\r");
+  double val;
+  if (!tryParseDouble(token.data(), token.data() + token.size(), &val)) {
+    return false;
+  }
+  (*out) = static_cast<real_t>(val);
+  return true;
+}
+
+static inline real_t parseRealView(std::string_view *sv,
+                                   double default_value = 0.0) {
+  real_t f = static_cast<real_t>(default_value);
+  parseRealView(sv, &f);
+  return f;
+}
+
+// Same result as parseVertexWithColor().
+static inline int parseVertexWithColorView(real_t *x, real_t *y, real_t *z,
+                                           real_t *r, real_t *g, real_t *b,
+                                           std::string_view *sv) {
+  (*x) = parseRealView(sv);
+  (*y) = parseRealView(sv);
+  (*z) = parseRealView(sv);
+
+  if (!parseRealView(sv, r)) {
+    (*r) = (*g) = (*b) = 1.0;
+    return 3;
+  }
+  if (!parseRealView(sv, g)) {
+    (*g) = (*b) = 1.0;
+    return 4;
+  }
+  if (!parseRealView(sv, b)) {
+    (*r) = (*g) = (*b) = 1.0;
+    return 3;  // treated as xyz
+  }
+  return 6;
+}
+
+// atoi() bounded by the view.
+static inline int parseIntView(std::string_view sv) {
+  skipSpaceView(&sv, " \t\v\f");
+  size_t i = 0;
+  bool negative = false;
+  if (i < sv.size() && (sv[i] == '+' || sv[i] == '-')) {
+    negative = sv[i] == '-';
+    i++;
+  }
+  unsigned int value = 0;
+  for (; i < sv.size() && IS_DIGIT(sv[i]); i++) {
+    value = value * 10 + static_cast<unsigned int>(sv[i] - '0');
+  }
+  return static_cast<int>(negative ? 0u - value : value);
+}
+
+// Same grammar as parseTriple(), but keeps the raw OBJ indices so relative
+// indices can be fixed up against the attribute counts at merge time.
+static vertex_index_t parseUnfixedTripleView(std::string_view *sv) {
+  vertex_index_t vi(kAbsentIndex);
+
+  vi.v_idx = parseIntView(*sv);
+  nextTokenView(sv, "/ \t\r");
+  if (sv->empty() || (*sv)[0] != '/') {
+    return vi;
+  }
+  sv->remove_prefix(1);
+
+  // i//k
+  if (!sv->empty() && (*sv)[0] == '/') {
+    sv->remove_prefix(1);
+    vi.vn_idx = parseIntView(*sv);
+    nextTokenView(sv, "/ \t\r");
+    return vi;
+  }
+
+  // i/j/k or i/j
+  vi.vt_idx = parseIntView(*sv);
+  nextTokenView(sv, "/ \t\r");
+  if (sv->empty() || (*sv)[0] != '/') {
+    return vi;
+  }
+
+  // i/j/k
+  sv->remove_prefix(1);  // skip '/'
+  vi.vn_idx = parseIntView(*sv);
+  nextTokenView(sv, "/ \t\r");
+  return vi;
+}
+
+// Tokenizes [begin, end), splitting lines exactly like safeGetline(). Only the
+// rare lines replayed through ParseObjLine are copied out of the buffer.
+static void ParseObjChunk(const char *begin, const char *end,
+                          obj_chunk *chunk) {
+  const char *p = begin;
+  while (p < end) {
+    const char *e = p;
+    while (e < end && *e != '\n' && *e != '\r') e++;
+    const std::string_view line(p, static_cast<size_t>(e - p));
+
+    p = e;
+    if (p < end && *p == '\r') {
+      p++;
+      if (p < end && *p == '\n') p++;
+    } else if (p < end) {
+      p++;
+    }
+
+    std::string_view token = line;
+    skipSpaceView(&token, " \t");
+
+    if (token.empty() || token[0] == '#') {
+      chunk->push(obj_chunk::COMMAND_SKIP);
+      continue;
+    }
+
+    // vertex
+    if (token.size() > 1 && token[0] == 'v' && IS_SPACE((token[1]))) {
+      token.remove_prefix(2);
+      real_t x, y, z;
+      real_t r, g, b;
+      int num_components =
+          parseVertexWithColorView(&x, &y, &z, &r, &g, &b, &token);
+      real_t values[6] = {x, y, z, r, g, b};
+      chunk->v.insert(chunk->v.end(), values, values + 6);
+      chunk->v_components.push_back(static_cast<unsigned char>(num_components));
+      chunk->push(obj_chunk::COMMAND_V);
+      continue;
+    }
+
+    // normal
+    if (token.size() > 2 && token[0] == 'v' && token[1] == 'n' &&
+        IS_SPACE((token[2]))) {
+      token.remove_prefix(3);
+      chunk->vn.push_back(parseRealView(&token));
+      chunk->vn.push_back(parseRealView(&token));
+      chunk->vn.push_back(parseRealView(&token));
+      chunk->push(obj_chunk::COMMAND_VN);
+      continue;
+    }
+
+    // texcoord
+    if (token.size() > 2 && token[0] == 'v' && token[1] == 't' &&
+        IS_SPACE((token[2]))) {
+      token.remove_prefix(3);
+      chunk->vt.push_back(parseRealView(&token));
+      chunk->vt.push_back(parseRealView(&token));
+      chunk->push(obj_chunk::COMMAND_VT);
+      continue;
+    }
+
+    // face
+    if (token.size() > 1 && token[0] == 'f' && IS_SPACE((token[1]))) {
+      token.remove_prefix(2);
+      skipSpaceView(&token, " \t");
+
+      int num_indices = 0;
+      while (!token.empty() && token[0] != '#') {
+        chunk->face_indices.push_back(parseUnfixedTripleView(&token));
+        num_indices++;
+        skipSpaceView(&token, " \t\r");
+      }
+      chunk->face_sizes.push_back(num_indices);
+      chunk->push(obj_chunk::COMMAND_F);
+      continue;
+    }
+
+    chunk->other_lines.push_back(std::string(line));
+    chunk->push(obj_chunk::COMMAND_OTHER);
+  }
+}
+
+// Applies one pre-parsed chunk to the parser state, in file order.
+static bool MergeObjChunk(obj_parse_state *state, const obj_chunk &chunk,
+                          std::vector<shape_t> *shapes,
+                          std::vector<material_t> *materials, std::string *warn,
+                          std::string *err, MaterialReader *readMatFn,
+                          bool triangulate, bool default_vcols_fallback) {
+  size_t v_pos = 0, vn_pos = 0, vt_pos = 0;
+  size_t face_pos = 0, index_pos = 0, other_pos = 0;
+
+  for (size_t c = 0; c < chunk.commands.size(); c++) {
+    const obj_chunk::command &cmd = chunk.commands[c];
+    switch (cmd.type) {
+      case obj_chunk::COMMAND_SKIP:
+        state->line_num += cmd.count;
+        break;
+
+      case obj_chunk::COMMAND_V:
+        for (size_t i = 0; i < cmd.count; i++, v_pos++) {
+          const real_t *p = &chunk.v[6 * v_pos];
+          int num_components = chunk.v_components[v_pos];
+          state->found_all_colors &= (num_components == 6);
+          state->v.insert(state->v.end(), p, p + 3);
+          state->vertex_weights.push_back(p[3]);
+          if ((num_components == 6) || default_vcols_fallback) {
+            state->vc.insert(state->vc.end(), p + 3, p + 6);
+          }
+        }
+        state->line_num += cmd.count;
+        break;
+
+      case obj_chunk::COMMAND_VN:
+        state->vn.insert(state->vn.end(), chunk.vn.begin() + 3 * vn_pos,
+                         chunk.vn.begin() + 3 * (vn_pos + cmd.count));
+        vn_pos += cmd.count;
+        state->line_num += cmd.count;
+        break;
+
+      case obj_chunk::COMMAND_VT:
+        state->vt.insert(state->vt.end(), chunk.vt.begin() + 2 * vt_pos,
+                         chunk.vt.begin() + 2 * (vt_pos + cmd.count));
+        vt_pos += cmd.count;
+        state->line_num += cmd.count;
+        break;
+
+      case obj_chunk::COMMAND_F: {
+        // No `v`/`vn`/`vt` line can occur inside a run of `f` lines.
+        const int vsize = static_cast<int>(state->v.size() / 3);
+        const int vnsize = static_cast<int>(state->vn.size() / 3);
+        const int vtsize = static_cast<int>(state->vt.size() / 2);
+
+        for (size_t i = 0; i < cmd.count; i++, face_pos++) {
+          state->line_num++;
+
+          warning_context context;
+          context.warn = warn;
+          context.line_number = state->line_num;
+
+          face_t face;
+          face.smoothing_group_id = state->current_smoothing_id;
+          face.vertex_indices.reserve(3);
+
+          for (int k = 0; k < chunk.face_sizes[face_pos]; k++, index_pos++) {
+            const vertex_index_t &raw = chunk.face_indices[index_pos];
+            vertex_index_t vi(-1);
+            bool ok = fixIndex(raw.v_idx, vsize, &vi.v_idx, false, context);
+            if (ok && raw.vt_idx != kAbsentIndex) {
+              ok = fixIndex(raw.vt_idx, vtsize, &vi.vt_idx, true, context);
+            }
+            if (ok && raw.vn_idx != kAbsentIndex) {
+              ok = fixIndex(raw.vn_idx, vnsize, &vi.vn_idx, true, context);
+            }
+            if (!ok) {
+              if (err) {
+                (*err) +=
+                    "Failed to parse `f' line (e.g. a zero value for vertex "
+                    "index or invalid relative vertex index). Line " +
+                    toString(state->line_num) + ").\n";
+              }
+              return false;
+            }
+
+            state->greatest_v_idx = (std::max)(state->greatest_v_idx, vi.v_idx);
+            state->greatest_vn_idx =
+                (std::max)(state->greatest_vn_idx, vi.vn_idx);
+            state->greatest_vt_idx =
+                (std::max)(state->greatest_vt_idx, vi.vt_idx);
+
+            face.vertex_indices.push_back(vi);
+          }
+
+          state->prim_group.faceGroup.push_back(face);
+        }
+        break;
+      }
+
+      case obj_chunk::COMMAND_OTHER:
+        for (size_t i = 0; i < cmd.count; i++, other_pos++) {
+          state->line_num++;
+          const char *token = chunk.other_lines[other_pos].c_str();
+          token += strspn(token, " \t");
+          if (!ParseObjLine(state, token, shapes, materials, warn, err,
+                            readMatFn, triangulate, default_vcols_fallback)) {
+            return false;
+          }
+        }
+        break;
+    }
+  }
+  return true;
+}
+
+// Tokenizes [buf, buf + len) and merges it into `state`, so a file can be fed
+// in consecutive newline-aligned pieces. The text is split into chunks that
+// are tokenized on `num_threads` threads while the calling thread merges
+// finished chunks in file order.
+static bool ParseObjBuffer(obj_parse_state *state, const char *buf, size_t len,
+                           std::vector<shape_t> *shapes,
+                           std::vector<material_t> *materials,
+                           std::string *warn, std::string *err,
+                           MaterialReader *readMatFn, bool triangulate,
+                           bool default_vcols_fallback, int num_threads) {
+  // A few chunks per thread even out uneven mixes of line types.
+  const size_t min_chunk_size = 1 << 20;
+  size_t num_chunks =
+      (std::min)(static_cast<size_t>((std::max)(num_threads, 1)) * 4,
+                 len / min_chunk_size + 1);
+
+  std::vector<const char *> bounds(1, buf);
+  for (size_t i = 1; i < num_chunks; i++) {
+    const char *p = (std::max)(buf + len / num_chunks * i, bounds.back());
+    const void *nl = memchr(p, '\n', static_cast<size_t>(buf + len - p));
+    bounds.push_back(nl ? static_cast<const char *>(nl) + 1 : buf + len);
+  }
+  bounds.push_back(buf + len);
+
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < num_chunks; i++) {
+      obj_chunk chunk;
+      ParseObjChunk(bounds[i], bounds[i + 1], &chunk);
+      if (!MergeObjChunk(state, chunk, shapes, materials, warn, err,
+                         readMatFn, triangulate, default_vcols_fallback)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<obj_chunk> chunks(num_chunks);
+  std::vector<char> done(num_chunks, 0);
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::atomic<size_t> next(0);
+  std::atomic<bool> abort(false);
+
+  std::vector<std::thread> workers;
+  size_t num_workers = (std::min)(static_cast<size_t>(num_threads), num_chunks);
+  for (size_t t = 0; t < num_workers; t++) {
+    workers.push_back(std::thread([&]() {
+      for (size_t i = next++; i < num_chunks && !abort; i = next++) {
+        ParseObjChunk(bounds[i], bounds[i + 1], &chunks[i]);
+        std::lock_guard<std::mutex> lock(mutex);
+        done[i] = 1;
+        ready.notify_all();
+      }
+    }));
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < num_chunks && ok; i++) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [&]() { return done[i] != 0; });
+    }
+    ok = MergeObjChunk(state, chunks[i], shapes, materials, warn, err,
+                       readMatFn, triangulate, default_vcols_fallback);
+    chunks[i] = obj_chunk();  // release the chunk as soon as it is merged
+  }
+  abort = !ok;
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+  return ok;
+}
+
+// Loads a .obj file by parsing it out of a sliding memory-mapped window.
+// Only one window is mapped at a time and each is unmapped once parsed, so
+// the file is never copied and its resident footprint stays bounded by the
+// window size. Returns false with `*mapped` unset if the file can't be mapped,
+// so the caller can fall back to stream reading.
+static bool LoadObjFromMappedFile(attrib_t *attrib,
+                                  std::vector<shape_t> *shapes,
+                                  std::vector<material_t> *materials,
+                                  std::string *warn, std::string *err,
+                                  const std::string &filename,
+                                  MaterialReader *readMatFn, bool triangulate,
+                                  bool default_vcols_fallback, int num_threads,
+                                  bool *mapped) {
+  *mapped = false;
+  mapped_file_window file;
+  if (!file.open(filename)) {
+    return false;
+  }
+
+  // Keep the window well inside the address space of 32-bit builds.
+  size_t window = sizeof(void *) >= 8 ? (size_t(256) << 20) : (size_t(32) << 20);
+  const unsigned long long size = file.size();
+  const unsigned long long granularity = mapped_file_window::granularity();
+
+  shapes->clear();
+  obj_parse_state state;
+
+  // `offset` is where the window is mapped and `skip` how many of its leading
+  // bytes belong to lines that were already parsed.
+  unsigned long long offset = 0;
+  size_t skip = 0;
+  while (offset + skip < size) {
+    size_t length = static_cast<size_t>(
+        (std::min)(static_cast<unsigned long long>(window), size - offset));
+    const char *data = file.map(offset, length);
+    if (!data) {
+      if (offset == 0) {
+        return false;
+      }
+      if (err) {
+        (*err) += "Failed to map [" + filename + "] at offset " +
+                  toString(offset) + ".\n";
+      }
+      return false;
+    }
+    *mapped = true;
+
+    // Parse up to the last complete line; the remainder is picked up by the
+    // next window. A window holding no line break at all is grown.
+    const char *begin = data + skip;
+    const char *end = data + length;
+    if (offset + length < size) {
+      while (end > begin && end[-1] != '\n') end--;
+      if (end == begin) {
+        window *= 2;
+        continue;
+      }
+    }
+
+    if (!ParseObjBuffer(&state, begin, static_cast<size_t>(end - begin), shapes,
+                        materials, warn, err, readMatFn, triangulate,
+                        default_vcols_fallback, num_threads)) {
+      return false;
+    }
+
+    unsigned long long consumed = offset + static_cast<size_t>(end - data);
+    offset = consumed - consumed % granularity;
+    skip = static_cast<size_t>(consumed - offset);
+  }
+  file.unmap();
+  *mapped = true;
+
+  return FinishObj(&state, attrib, shapes, warn, triangulate,
+                   default_vcols_fallback);
+}
+
 bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
                          void *user_data /*= NULL*/,
                          MaterialReader *readMatFn /*= NULL*/,
@@ -3468,6 +4192,27 @@ bool ObjReader::ParseFromFile(const std::string &filename,
     mtl_search_path = config.mtl_search_path;
   }
 
+  std::string mtl_base_dir = mtl_search_path;
+  if (!mtl_base_dir.empty()) {
+#ifndef _WIN32
+    const char dirsep = '/';
+#else
+    const char dirsep = '\\';
+#endif
+    if (mtl_base_dir[mtl_base_dir.length() - 1] != dirsep)
+      mtl_base_dir += dirsep;
+  }
+  MaterialFileReader matFileReader(mtl_base_dir);
+
+  bool mapped = false;
+  valid_ = LoadObjFromMappedFile(&attrib_, &shapes_, &materials_, &warning_,
+                                 &error_, filename, &matFileReader,
+                                 config.triangulate, config.vertex_color,
+                                 config.num_threads, &mapped);
+  if (mapped) {
+    return valid_;
+  }
+
   valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_,
                    filename.c_str(), mtl_search_path.c_str(),
                    config.triangulate, config.vertex_color);
@@ -0,0 +1,57 @@
+#include "uniform_buffers.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace gl {
+
+    GLuint UniformBuffers::frameBuffer = 0;
+
+    void UniformBuffers::setFrame(const FrameUniforms& frame) {
+        if (!frameBuffer) glGenBuffers(1, &frameBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+        // Orphaned each frame so the write never waits on last frame's draws.
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), &frame, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FrameBlock, frameBuffer);
+    }
+
+    void UniformBuffers::uploadMaterials(DataTex& data) {
+        if (data.materials.empty() || data.materialBuffer) return;
+
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        const size_t align = static_cast<size_t>(std::max(alignment, 1));
+        const size_t stride = (sizeof(MaterialUniforms) + align - 1) / align * align;
+
+        std::vector<unsigned char> records(stride * data.materials.size());
+        for (size_t i = 0; i < data.materials.size(); i++) {
+            const Material& m = data.materials[i];
+            MaterialUniforms u{};
+            u.ambient = glm::vec4(m.ambient, 0.0f);
+            u.diffuse = glm::vec4(m.diffuse, 0.0f);
+            u.specular = glm::vec4(m.specular, 0.0f);
+            u.transmittance = glm::vec4(m.transmittance, 0.0f);
+            u.emission = glm::vec4(m.emission, 0.0f);
+            u.shininess = m.shininess;
+            u.ior = m.ior;
+            u.dissolve = m.dissolve;
+            u.illum = m.illum;
+            Texture::MaterialTextureSlots(m, data, u.textures);
+            std::memcpy(records.data() + i * stride, &u, sizeof(u));
+        }
+
+        glGenBuffers(1, &data.materialBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, data.materialBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(records.size()), records.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        data.materialStride = stride;
+    }
+
+    void UniformBuffers::bindMaterial(const DataTex& data, size_t material) {
+        if (!data.materialBuffer) return;
+        glBindBufferRange(GL_UNIFORM_BUFFER, MaterialBlock, data.materialBuffer,
+                          static_cast<GLintptr>(material * data.materialStride), sizeof(MaterialUniforms));
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "texture.h"
+
+namespace gl {
+
+// Uniform block binding points, assigned to every program by Shader::init_program.
+enum UniformBlockBinding : GLuint {
+    FrameBlock = 0,
+    MaterialBlock = 1,
+};
+
+// std140 mirror of the shaders' Frame block: what every program reads once per frame.
+struct FrameUniforms {
+    static constexpr int max_lights = 5;
+
+    glm::mat4 view{1.0f};
+    glm::mat4 projection{1.0f};
+    glm::mat4 viewProj{1.0f};
+    glm::vec4 lightPosn[max_lights]{};
+    glm::vec4 lightCol[max_lights]{}; // alpha 0 switches a light off
+    glm::vec4 sunDir{0.0f};           // xyz
+    glm::vec4 sunColor{0.0f};
+    glm::vec4 ambient{0.0f};
+};
+
+// std140 mirror of the shaders' Material block.
+struct MaterialUniforms {
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    glm::vec4 transmittance;
+    glm::vec4 emission;
+    float shininess;
+    float ior;
+    float dissolve;
+    int32_t illum;
+    glm::ivec4 textures[MaterialSlotCount]; // unit and layer per slot, as ivec2 with std140 padding
+};
+
+static_assert(sizeof(FrameUniforms) == 400);
+static_assert(sizeof(MaterialUniforms) == 208);
+
+// The Frame block's buffer, rewritten each frame, and each model's Material
+// records, written once at load so a material change is a glBindBufferRange.
+class UniformBuffers {
+public:
+    static void setFrame(const FrameUniforms& frame);
+    // One record per material of data, each aligned for binding on its own.
+    // Needs the materials' texture layers placed.
+    static void uploadMaterials(DataTex& data);
+    static void bindMaterial(const DataTex& data, size_t material);
+
+private:
+    static GLuint frameBuffer;
+};
+}
@@ -0,0 +1,116 @@
+#include "upload_ring.h"
+
+#include <cstring>
+
+namespace gl {
+
+    namespace {
+        constexpr size_t kRingBytes = 64 << 20;
+        // Staged regions start on cache-line boundaries.
+        constexpr size_t kAlignment = 64;
+        // Longest single wait for a fence before checking again, in nanoseconds.
+        constexpr GLuint64 kWaitTimeout = 100'000'000;
+    }
+
+    GLuint UploadRing::ring = 0;
+    unsigned char* UploadRing::mapped = nullptr;
+    size_t UploadRing::head = 0;
+    size_t UploadRing::used = 0;
+    size_t UploadRing::batchBytes = 0;
+    std::deque<UploadRing::Segment> UploadRing::segments;
+    GLuint UploadRing::orphanBuffer = 0;
+    size_t UploadRing::staged = 0;
+
+    bool UploadRing::initialize() {
+        static bool tried = false;
+        if (tried) return mapped != nullptr;
+        tried = true;
+        if (!GLEW_VERSION_4_4 && !GLEW_ARB_buffer_storage) return false;
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &ring);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, kRingBytes, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, kRingBytes, flags));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!mapped) {
+            glDeleteBuffers(1, &ring);
+            ring = 0;
+        }
+        return mapped != nullptr;
+    }
+
+    // Frees the segments the GPU has finished reading. With wait, blocks until
+    // at least the oldest one is free.
+    void UploadRing::retire(bool wait) {
+        while (!segments.empty()) {
+            Segment& oldest = segments.front();
+            GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+            while (wait && status == GL_TIMEOUT_EXPIRED) {
+                status = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, kWaitTimeout);
+            }
+            if (status == GL_TIMEOUT_EXPIRED) return;
+            glDeleteSync(oldest.fence);
+            used -= oldest.bytes;
+            segments.pop_front();
+            wait = false;
+        }
+        // Nothing in flight: start over at the front so the next upload needs no wrap.
+        if (used == 0) head = 0;
+    }
+
+    const void* UploadRing::stage(const void* pixels, size_t size) {
+        staged += size;
+        const size_t bytes = (size + kAlignment - 1) & ~(kAlignment - 1);
+        if (!initialize() || bytes > kRingBytes) return orphan(pixels, size);
+
+        retire(false);
+        size_t pad = head + bytes > kRingBytes ? kRingBytes - head : 0;
+        while (used + pad + bytes > kRingBytes) {
+            // The space is held by uploads issued since the last submit; fence them to wait on.
+            if (segments.empty()) {
+                segments.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), batchBytes});
+                batchBytes = 0;
+            }
+            retire(true);
+            pad = head + bytes > kRingBytes ? kRingBytes - head : 0;
+        }
+
+        const size_t offset = pad ? 0 : head;
+        std::memcpy(mapped + offset, pixels, size);
+        head = offset + bytes;
+        used += pad + bytes;
+        batchBytes += pad + bytes;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+        return reinterpret_cast<const void*>(offset);
+    }
+
+    // Fallback for drivers without persistent mapping and for uploads larger than
+    // the ring: fresh storage per upload, so no upload waits for an earlier one.
+    const void* UploadRing::orphan(const void* pixels, size_t size) {
+        if (!orphanBuffer) glGenBuffers(1, &orphanBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, orphanBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_DRAW);
+        void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size),
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!dst) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return pixels;
+        }
+        std::memcpy(dst, pixels, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        return nullptr;
+    }
+
+    void UploadRing::submit() {
+        if (batchBytes > 0) {
+            segments.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), batchBytes});
+            batchBytes = 0;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    size_t UploadRing::bytesStaged() {
+        return staged;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <GL/glew.h>
+
+namespace gl {
+
+// Staging memory for texture uploads. Pixels are copied into a pixel unpack
+// buffer and glTex(Sub)Image reads them from there, so the call returns without
+// the driver copying out of client memory. With GL 4.4 or ARB_buffer_storage
+// the memory is a persistently mapped ring whose regions are recycled once a
+// fence shows the GPU has read them; otherwise each upload orphans one buffer.
+class UploadRing {
+public:
+    // Copies size bytes of pixels into staging memory and binds it to
+    // GL_PIXEL_UNPACK_BUFFER. Returns what to pass as the pixel pointer of the
+    // next glTex(Sub)Image call: an offset into the bound buffer.
+    static const void* stage(const void* pixels, size_t size);
+    // Ends a group of staged uploads: fences the memory they read and unbinds
+    // the unpack buffer so client-memory uploads elsewhere keep working.
+    static void submit();
+
+    // Bytes staged since startup; callers diff it to budget uploads per frame.
+    [[nodiscard]] static size_t bytesStaged();
+
+private:
+    struct Segment {
+        GLsync fence;
+        size_t bytes; // ring bytes freed when fence signals, padding included
+    };
+
+    static bool initialize();
+    static const void* orphan(const void* pixels, size_t size);
+    static void retire(bool wait);
+
+    static GLuint ring;
+    static unsigned char* mapped;
+    static size_t head;       // next free byte of the ring
+    static size_t used;       // bytes the GPU may still read, from the oldest segment to head
+    static size_t batchBytes; // part of used staged since the last submit
+    static std::deque<Segment> segments;
+    static GLuint orphanBuffer;
+    static size_t staged;
+};
+}
@@ -0,0 +1,122 @@
+#include "vertex_format.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+namespace gl {
+
+    namespace {
+        struct PackedVertex {
+            uint16_t position[3]; // unorm16 xyz
+            int8_t tangent[2];    // snorm8 VertexLayout::encodeTangent
+            int16_t normal[2];    // snorm16 octahedral
+            uint16_t texcoord[2]; // half float
+        };
+        static_assert(sizeof(PackedVertex) == 16);
+
+        // Octahedral mapping of a unit vector onto [-1, 1]^2.
+        glm::vec2 octEncode(glm::vec3 n) {
+            float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+            if (l1 == 0.0f) return glm::vec2(0.0f);
+            n /= l1;
+            glm::vec2 p(n.x, n.y);
+            if (n.z < 0.0f) {
+                glm::vec2 sign(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+                p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+            }
+            return p;
+        }
+
+        uint16_t toUnorm16(float v) {
+            return static_cast<uint16_t>(std::lround(glm::clamp(v, 0.0f, 1.0f) * 65535.0f));
+        }
+
+        int16_t toSnorm16(float v) {
+            return static_cast<int16_t>(std::lround(glm::clamp(v, -1.0f, 1.0f) * 32767.0f));
+        }
+
+        int8_t toSnorm8(float v) {
+            return static_cast<int8_t>(std::lround(glm::clamp(v, -1.0f, 1.0f) * 127.0f));
+        }
+    }
+
+    GLsizei VertexLayout::stride(VertexFormat format) {
+        switch (format) {
+            case VertexFormat::Packed16:
+                return sizeof(PackedVertex);
+            case VertexFormat::Float32:
+            default:
+                return floats_per_vertex * sizeof(float);
+        }
+    }
+
+    PositionQuantization VertexLayout::quantization(VertexFormat format, const glm::vec3& bmin, const glm::vec3& bmax) {
+        PositionQuantization q;
+        if (format == VertexFormat::Packed16 && glm::all(glm::lessThanEqual(bmin, bmax))) {
+            q.offset = bmin;
+            // Keep flat axes decodable instead of dividing by zero when packing.
+            q.scale = glm::max(bmax - bmin, glm::vec3(1e-6f));
+        }
+        return q;
+    }
+
+    void VertexLayout::setAttributes(VertexFormat format) {
+        GLsizei s = stride(format);
+        glEnableVertexAttribArray(0); // pos
+        glEnableVertexAttribArray(1); // normal
+        glEnableVertexAttribArray(2); // texcoord
+        glEnableVertexAttribArray(3); // tangent
+        if (format == VertexFormat::Packed16) {
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, s, (void*)offsetof(PackedVertex, position));
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, s, (void*)offsetof(PackedVertex, normal));
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, s, (void*)offsetof(PackedVertex, texcoord));
+            glVertexAttribPointer(3, 2, GL_BYTE, GL_TRUE, s, (void*)offsetof(PackedVertex, tangent));
+        } else {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, s, (void*)0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, s, (void*)(3 * sizeof(float)));
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, s, (void*)(6 * sizeof(float)));
+            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, s, (void*)(8 * sizeof(float)));
+        }
+    }
+
+    glm::vec2 VertexLayout::encodeTangent(const glm::vec3& tangent, float sign) {
+        glm::vec2 e = octEncode(tangent);
+        // 1..127 over 127 once quantized to snorm8, so x never rounds to zero.
+        float x = ((glm::clamp(e.x, -1.0f, 1.0f) + 1.0f) * 63.0f + 1.0f) / 127.0f;
+        return {sign < 0.0f ? -x : x, e.y};
+    }
+
+    std::vector<unsigned char> VertexLayout::pack(VertexFormat format, const float* vertices, size_t vertexCount,
+                                                  const PositionQuantization& q) {
+        std::vector<unsigned char> bytes(vertexCount * stride(format));
+        if (format != VertexFormat::Packed16) {
+            std::memcpy(bytes.data(), vertices, bytes.size());
+            return bytes;
+        }
+
+        auto* out = reinterpret_cast<PackedVertex*>(bytes.data());
+        for (size_t i = 0; i < vertexCount; i++) {
+            const float* v = vertices + floats_per_vertex * i;
+            PackedVertex& p = out[i];
+
+            glm::vec3 t = (glm::vec3(v[0], v[1], v[2]) - q.offset) / q.scale;
+            p.position[0] = toUnorm16(t.x);
+            p.position[1] = toUnorm16(t.y);
+            p.position[2] = toUnorm16(t.z);
+            p.tangent[0] = toSnorm8(v[8]);
+            p.tangent[1] = toSnorm8(v[9]);
+
+            glm::vec2 n = octEncode(glm::vec3(v[3], v[4], v[5]));
+            p.normal[0] = toSnorm16(n.x);
+            p.normal[1] = toSnorm16(n.y);
+
+            uint32_t uv = glm::packHalf2x16(glm::vec2(v[6], v[7]));
+            p.texcoord[0] = static_cast<uint16_t>(uv & 0xFFFF);
+            p.texcoord[1] = static_cast<uint16_t>(uv >> 16);
+
+        }
+        return bytes;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "debug.h"
+
+namespace gl {
+
+// Vertex layouts geometry can be uploaded in. Attribute locations are the same
+// for all of them: 0 position, 1 normal, 2 texcoord, 3 tangent.
+enum class VertexFormat : uint8_t {
+    Float32,  // 40 bytes: pos(3), normal(3), tex(2), tangent(2), all 32-bit floats; the tangent is
+              // encoded as by VertexLayout::encodeTangent
+    Packed16, // 16 bytes: pos unorm16x3 over the model AABB, octahedral tangent snorm8x2 with the
+              // bitangent sign, octahedral normal snorm16x2, tex half2
+    Count
+};
+
+// Maps decoded positions back to model space: p = offset + q * scale, where q is
+// the unorm16 value in [0, 1]. Identity for unquantized formats.
+struct PositionQuantization {
+    glm::vec3 offset{0.0f};
+    glm::vec3 scale{1.0f};
+};
+
+class VertexLayout {
+public:
+    // Floats per vertex in the Float32 layout, which loading works in.
+    static constexpr size_t floats_per_vertex = 10;
+
+    static GLsizei stride(VertexFormat format);
+    static PositionQuantization quantization(VertexFormat format, const glm::vec3& bmin, const glm::vec3& bmax);
+
+    // Points attributes 0-3 at the currently bound VAO and GL_ARRAY_BUFFER.
+    static void setAttributes(VertexFormat format);
+
+    // Octahedral tangent with the bitangent sign folded into x, as both layouts
+    // store it: |x| in [1/127, 1] maps the octahedral x, on the side of zero
+    // given by the sign. Packed16 keeps it as snorm8, 7 bits for x.
+    static glm::vec2 encodeTangent(const glm::vec3& tangent, float sign);
+
+    // Converts vertexCount Float32 vertices to format. Float32 is copied unchanged.
+    static std::vector<unsigned char> pack(VertexFormat format, const float* vertices, size_t vertexCount,
+                                           const PositionQuantization& q);
+};
+}
@@ -1,4 +1,5 @@
 
+#include <filesystem>
 #include <vector>
 #include <GL/glew.h>
 #include <glm/gtc/type_ptr.hpp>
@@ -7,6 +8,10 @@
 #include "shaders.h"
 #include "mesh.h"
 #include "camera.h"
+#include "model_loader.h"
+#include "render_state.h"
+#include "texture_streamer.h"
+#include "uniform_buffers.h"
 #include <imgui.h>
 
 #include "terrain.h"
@@ -19,6 +24,15 @@ bool drawTerrain = false;
 
 namespace gl {
 
+    // GL upload time granted to background model loads per frame.
+    constexpr double kUploadBudgetMs = 4.0;
+    // Texture data those loads may stage per frame.
+    constexpr size_t kUploadBudgetBytes = 16 << 20;
+    // GL time granted to texture streaming per frame.
+    constexpr double kStreamBudgetMs = 2.0;
+    // Closest the camera may get to geometry with collision on, in world units.
+    constexpr float kCollisionDistance = 0.02f;
+
     float Window::sense = 1.0f;
     bool Window::active_cursor = false;
     bool Window::cursorInsideWindow = true;
@@ -26,6 +40,13 @@ namespace gl {
     GLuint Window::terrainProgram = 0;
 
     int Window::render_mode = 0;
+    bool Window::packed_vertices = false;
+    bool Window::optimize_meshes = false;
+    bool Window::generate_lods = false;
+    bool Window::compress_textures = false;
+    bool Window::frustum_culling = true;
+    bool Window::camera_collision = false;
+    bool Window::occlusion_culling = false;
     bool Window::keys[1024] = { false };
     int Window::window_width = 1920;
     int Window::window_height = 1080;
@@ -51,6 +72,19 @@ namespace gl {
 
     AudioEngine& Window::audio() { return AudioEngine::instance(); }
 
+    VertexFormat Window::vertexFormat() {
+        return packed_vertices ? VertexFormat::Packed16 : VertexFormat::Float32;
+    }
+
+    LoadConfig Window::loadConfig() {
+        LoadConfig config;
+        config.vertex_format = vertexFormat();
+        config.optimize = optimize_meshes;
+        config.generate_lods = generate_lods;
+        config.compress_textures = compress_textures;
+        return config;
+    }
+
     void Window::resize_window(GLFWwindow* window, int width, int height) {
         window_width = width;
         window_height = height;
@@ -66,7 +100,7 @@ namespace gl {
         glm::mat4 proj = gl::Camera::getProjection(aspect);
         glm::mat4 modelView = gl::Camera::getViewMatrix();
         glm::mat4 MVP = proj * modelView;
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "uMVP"),
+        glUniformMatrix4fv(Shader::uniform(shaderProgram, "uMVP"),
                                     1, GL_FALSE, glm::value_ptr(MVP));
     }
     void Window::keyboard(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -116,7 +150,7 @@ namespace gl {
         std::cout << "Dropped files: " << count << std::endl;
         for (int i = 0; i < count; i++) {
             std::cout << "File " << i + 1 << ": " << paths[i] << std::endl;
-            m_data.push_back(gl::Mesh::load_obj(paths[i]));
+            ModelLoader::request(paths[i], loadConfig());
         }
     }
 
@@ -179,6 +213,8 @@ namespace gl {
         GLuint vertexShader = gl::Shader::init_shaders(GL_VERTEX_SHADER, "../res/shaders/vertex.glsl");
         GLuint fragmentShader = gl::Shader::init_shaders(GL_FRAGMENT_SHADER, "../res/shaders/fragment.glsl");
         shaderProgram = gl::Shader::init_program(vertexShader, fragmentShader);
+        Texture::SetTextureArrayUnits(shaderProgram);
+        gl::OcclusionCuller::init();
 
         glUseProgram(shaderProgram);
 
@@ -187,23 +223,44 @@ namespace gl {
         audio().loadSound("../data/lion.wav", "lion");
         audio().loadMusic("../data/minecraft.mp3", "music");
         // =========== LOADING .OBJ ===========
+        terrain.vertexFormat_ = vertexFormat();
         terrain.generate("../data/");
-        DataTex newObj = gl::Mesh::load_obj(filename);
-        m_data.push_back(newObj);
+        ModelLoader::request(filename, loadConfig());
 
         return 1;
     }
 
+    glm::mat4 Window::modelMatrix(const DataTex& data) {
+        // Compute scaling factor
+        glm::mat2x3 borders = {data.bmin, data.bmax};
+        float maxExtent = std::max({0.5f * (borders[1][0] - borders[0][0]),
+                                    0.5f * (borders[1][1] - borders[0][1]),
+                                    0.5f * (borders[1][2] - borders[0][2])});
+        return glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / maxExtent));
+    }
+
+    bool Window::raycast(const glm::vec3& origin, const glm::vec3& direction, float& tMax, size_t& model,
+                         RayHit& hit) {
+        bool found = false;
+        for (size_t i = 0; i < m_data.size(); i++) {
+            if (m_data[i].m_draw_objects.empty()) continue;
+            // Unnormalized object-space direction, so t is the same in both spaces.
+            glm::mat4 toObject = glm::inverse(modelMatrix(m_data[i]));
+            glm::vec3 o(toObject * glm::vec4(origin, 1.0f));
+            glm::vec3 d(toObject * glm::vec4(direction, 0.0f));
+            if (Mesh::raycast(m_data[i], o, d, tMax, hit)) {
+                model = i;
+                found = true;
+            }
+        }
+        return found;
+    }
+
     void Window::display() {
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        const int num_lights = 5;
-        if(drawTerrain) {
-            terrain.render(render_mode);
-            return;
-        }
-
-        glUseProgram(shaderProgram);
+        RenderState::beginFrame();
+        const int num_lights = FrameUniforms::max_lights;
         // Define your lights
         std::array<glm::vec4, num_lights> lightPosn {
                 glm::vec4(0.f, 1.f, 2.f, 1.f),
@@ -221,39 +278,36 @@ namespace gl {
                 glm::vec4(1.f, 1.f, 1.f, 0.2f)
         };
 
-        // Send arrays (positions & colors)
-        glUniform4fv(glGetUniformLocation(shaderProgram, "light_posn"), num_lights, glm::value_ptr(lightPosn[0]));
-        glUniform4fv(glGetUniformLocation(shaderProgram, "light_col"), num_lights, glm::value_ptr(lightCol[0]));
+        // Everything the programs share this frame, in the Frame uniform block
+        glm::mat4 view = gl::Camera::getViewMatrix();
+        glm::mat4 proj = gl::Camera::getProjection(1920.0f / 1080.0f);
+        FrameUniforms frame;
+        frame.view = view;
+        frame.projection = proj;
+        frame.viewProj = proj * view;
+        std::copy(lightPosn.begin(), lightPosn.end(), frame.lightPosn);
+        std::copy(lightCol.begin(), lightCol.end(), frame.lightCol);
+        terrain.fillFrame(frame);
+        UniformBuffers::setFrame(frame);
 
-        for (auto& data : m_data) {
-            // Compute scaling factor
-            glm::mat2x3 borders = {data.m_draw_objects[0].bmin, data.m_draw_objects[0].bmax};
-            float maxExtent = std::max({0.5f * (borders[1][0] - borders[0][0]),
-                                        0.5f * (borders[1][1] - borders[0][1]),
-                                        0.5f * (borders[1][2] - borders[0][2])});
-
-            glm::mat4 view = gl::Camera::getViewMatrix();
-            glm::mat4 proj = gl::Camera::getProjection(1920.0f / 1080.0f);
-            glm:: mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / maxExtent));
-            glm::mat4 MVP = proj * view * model;
-
-            // Send MVP to shader
+        if(drawTerrain) {
+            terrain.render(render_mode);
+            return;
+        }
 
-            glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "uMVP"),
-                               1, GL_FALSE, glm::value_ptr(MVP));
+        Mesh::cull_stats = {};
+        Mesh::draw_stats = {};
+        for (auto& data : m_data) {
+            if (data.m_draw_objects.empty()) continue;
 
-            if (render_mode == 0){
-                gl::Mesh::draw(GL_FRONT_AND_BACK, GL_FILL, shaderProgram, data);
-            }
-            if (render_mode == 1){
-                glLineWidth(1);
-                gl::Mesh::draw(GL_FRONT_AND_BACK, GL_LINE, shaderProgram, data);
-            }
-            if (render_mode == 2){
-                glPointSize(5);
-                gl::Mesh::draw(GL_FRONT_AND_BACK, GL_POINT, shaderProgram, data);
-            }
+            glm::mat4 model = modelMatrix(data);
+            glm::mat4 MVP = proj * view * model;
+            gl::Mesh::queue(shaderProgram, data, DrawView{model, MVP, frustum_culling, occlusion_culling});
         }
+        if (render_mode == 1) glLineWidth(1);
+        if (render_mode == 2) glPointSize(5);
+        GLenum polygonMode = render_mode == 1 ? GL_LINE : (render_mode == 2 ? GL_POINT : GL_FILL);
+        gl::Mesh::submit(GL_FRONT_AND_BACK, polygonMode);
 
         audio().setListener(Camera::get_position());
 
@@ -293,7 +347,18 @@ namespace gl {
 
         if (glm::length(direction) > 0) {
             direction = glm::normalize(direction);
+            glm::vec3 from = gl::Camera::get_position();
             gl::Camera::move(direction, speed * deltaTime);
+
+            // Stay put when the step would pass through geometry.
+            glm::vec3 step = gl::Camera::get_position() - from;
+            float length = glm::length(step);
+            size_t model;
+            RayHit hit;
+            float tMax = length + kCollisionDistance;
+            if (camera_collision && length > 0.0f && raycast(from, step / length, tMax, model, hit)) {
+                gl::Camera::set_position(from);
+            }
         }
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -302,19 +367,84 @@ namespace gl {
 
         ImGui::SetNextWindowSize(ImVec2(current_vp_width, current_vp_height));
         ////////////////////////////////////////////////////////////////////////////////////////////////
+        ModelLoader::update(kUploadBudgetMs, kUploadBudgetBytes, m_data);
+        TextureStreamer::update(m_data, kStreamBudgetMs);
+        terrain.updateSkyboxes();
         display();
 
         ImGui::Begin("Object Properties");
         ImGui::Text("Application %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        if (occlusion_culling) {
+            const CullStats& stats = Mesh::cull_stats;
+            float hitRate = stats.queried ? 100.0f * stats.occluded / stats.queried : 0.0f;
+            ImGui::Text("Occlusion: %zu of %zu queried hidden (%.0f%%)", stats.occluded, stats.queried, hitRate);
+        }
         ImGui::Text(" ");
 
         ////////////////////////////////////////////////////////////////////////////////////////////////
 
+        if (ModelLoader::busy()) {
+            ImGui::Separator(); ImGui::TextColored({0.0f, 1.0f, 1.0f, 1.0f}, "Loading"); ImGui::Separator();
+            for (const auto& p : ModelLoader::progress()) {
+                std::string name = std::filesystem::path(p.filename).filename().string();
+                ImGui::Text("%s", name.c_str());
+                ImGui::ProgressBar(p.fraction, ImVec2(-1.0f, 0.0f), p.stage);
+            }
+        }
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////
+
         ImGui::Separator(); ImGui::TextColored({0.0f,1.0f,1.0f,1.0f}, "Render Mode"); ImGui::Separator();
         ImGui::Text("Primitive object ");
         ImGui::Button("Smooth", ImVec2(50.0f, 25.0f)) ? render_mode = 0 : 0; ImGui::SameLine();
         ImGui::Button("Lines", ImVec2(50.0f, 25.0f)) ? render_mode = 1 : 0; ImGui::SameLine();
         ImGui::Button("Pnt Cld", ImVec2(50.0f, 25.0f)) ? render_mode = 2 : 0; ImGui::SameLine();
+        ImGui::NewLine();
+        if (ImGui::Checkbox("Packed vertices (next load)", &packed_vertices)) {
+            terrain.vertexFormat_ = vertexFormat();
+            terrain.regenerate();
+        }
+        ImGui::Checkbox("Optimize meshes (next load)", &optimize_meshes);
+        ImGui::Checkbox("Generate LODs (next load)", &generate_lods);
+        ImGui::Checkbox("Compress textures (next load)", &compress_textures);
+        ImGui::Checkbox("Texture streaming (next load)", &TextureStreamer::settings.enabled);
+        ImGui::SliderInt("Texture budget (MB)", &TextureStreamer::settings.budgetMB, 64, 4096);
+        {
+            TextureStreamer::Stats stats = TextureStreamer::stats(m_data);
+            if (stats.fullBytes) {
+                ImGui::Text("Textures: %.0f of %.0f MB resident", stats.residentBytes / 1048576.0,
+                            stats.fullBytes / 1048576.0);
+            }
+        }
+        ImGui::Checkbox("Frustum culling", &frustum_culling);
+        ImGui::Checkbox("Occlusion culling", &occlusion_culling);
+        {
+            TextureFiltering& filtering = Texture::filtering;
+            bool changed = ImGui::Checkbox("Mipmaps", &filtering.mipmaps);
+            changed |= ImGui::SliderFloat("Anisotropy", &filtering.anisotropy, 1.0f, 16.0f, "%.0fx");
+            if (changed) {
+                for (const auto& data : m_data) {
+                    for (const auto& array : data.textureArrays) Texture::ApplyFiltering(array.id, GL_TEXTURE_2D_ARRAY);
+                }
+                terrain.applyFiltering();
+            }
+        }
+        ImGui::Text("Objects: %zu drawn, %zu culled", Mesh::cull_stats.submitted, Mesh::cull_stats.culled);
+        ImGui::Text("Draw list: %zu records in %zu draw calls, sorted in %.3f ms", Mesh::draw_stats.records,
+                    Mesh::draw_stats.drawCalls, Mesh::draw_stats.sortMs);
+        ImGui::Text("GL state: %zu changes sent, %zu redundant skipped", RenderState::stats.issued,
+                    RenderState::stats.elided);
+        ImGui::Checkbox("Camera collision", &camera_collision);
+        {
+            size_t model;
+            RayHit hit;
+            float tMax = gl::Camera::far;
+            if (raycast(gl::Camera::get_position(), gl::Camera::get_front(), tMax, model, hit)) {
+                ImGui::Text("Looking at: model %zu, object %zu (%.2f away)", model, hit.object, hit.distance);
+            } else {
+                ImGui::Text("Looking at: nothing");
+            }
+        }
 
         ////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -20,10 +20,31 @@ public:
     static void drag_drop(GLFWwindow * window, int count, const char** paths);
     static int initialize(const std::string& filename);
     static AudioEngine& audio();
+    static VertexFormat vertexFormat();
+    static LoadConfig loadConfig();
+    static glm::mat4 modelMatrix(const DataTex& data);
+    // Closest hit of a world-space ray over every loaded model.
+    static bool raycast(const glm::vec3& origin, const glm::vec3& direction, float& tMax, size_t& model,
+                        RayHit& hit);
     static void display();
     static void update();
     static bool isActive();
 
+    // Load models (and the terrain) with the 16-byte packed vertex layout.
+    static bool packed_vertices;
+    // Run the vertex cache / overdraw optimizer on loaded models.
+    static bool optimize_meshes;
+    // Build simplified levels of detail for loaded models.
+    static bool generate_lods;
+    // Block-compress model textures, cached on disk as DDS.
+    static bool compress_textures;
+    // Skip objects whose bounds are outside the view frustum.
+    static bool frustum_culling;
+    // Stop the camera before it moves through geometry.
+    static bool camera_collision;
+    // Skip objects hidden behind others, using hardware occlusion queries.
+    static bool occlusion_culling;
+
 private:
     // Variables to hold state
     static float sense;